@@ -0,0 +1,89 @@
+/*
+    计数器吞吐量基准：对比std::mutex保护的计数、单个std::atomic和ShardedCounter
+    负载：每个线程对同一个计数器执行iterations次加一
+    用法：counter_bench [最大线程数] [每个线程的加一次数]
+    线程数从1开始按2的倍数增加到最大线程数，输出每秒完成的加一次数
+*/
+#include<iostream>
+#include<iomanip>
+#include<atomic>
+#include<chrono>
+#include<cstdlib>
+#include<mutex>
+#include<thread>
+#include<vector>
+#include"sharded_counter.h"
+
+//原来multi_thread_mutex.cpp中的实现
+class MutexCounter{
+    private:
+        std::mutex mutex_;
+        long count_=0;
+    public:
+        void increment(){
+            std::lock_guard<std::mutex>lock(mutex_);
+            ++count_;
+        }
+        long getCount(){
+            std::lock_guard<std::mutex>lock(mutex_);
+            return count_;
+        }
+};
+
+class AtomicCounter{
+    private:
+        std::atomic<long>count_{0};
+    public:
+        void increment(){count_.fetch_add(1,std::memory_order_relaxed);}
+        long getCount()const{return count_.load(std::memory_order_relaxed);}
+};
+
+template<typename Counter>
+static double run(size_t threads,long iterations){
+    Counter counter;
+    std::atomic<bool>go{false};
+    std::vector<std::thread>workers;
+    for(size_t t=0;t<threads;++t){
+        workers.emplace_back([&]{
+            while(!go.load())
+                std::this_thread::yield();
+            for(long i=0;i<iterations;++i)
+                counter.increment();
+        });
+    }
+    auto start=std::chrono::steady_clock::now();
+    go.store(true);
+    for(std::thread& w:workers)
+        w.join();
+    std::chrono::duration<double>elapsed=std::chrono::steady_clock::now()-start;
+    long total=static_cast<long>(threads)*iterations;
+    if(static_cast<long>(counter.getCount())!=total)
+        std::cerr<<"count mismatch: "<<counter.getCount()<<" != "<<total<<std::endl;
+    return total/elapsed.count();
+}
+
+int main(int argc,char** argv){
+    size_t maxThreads=argc>1?std::strtoul(argv[1],nullptr,10):std::thread::hardware_concurrency();
+    long iterations=argc>2?std::atol(argv[2]):2000000;
+    if(maxThreads==0)
+        maxThreads=1;
+
+    std::cout<<std::left<<std::setw(10)<<"threads"
+             <<std::setw(20)<<"mutex(ops/s)"
+             <<std::setw(20)<<"atomic(ops/s)"
+             <<std::setw(20)<<"sharded(ops/s)"<<std::endl;
+    for(size_t t=1;;t*=2){
+        if(t>maxThreads)
+            t=maxThreads;
+        double mutex=run<MutexCounter>(t,iterations);
+        double atomic=run<AtomicCounter>(t,iterations);
+        double sharded=run<ShardedCounter>(t,iterations);
+        std::cout<<std::left<<std::setw(10)<<t
+                 <<std::setw(20)<<std::fixed<<std::setprecision(0)<<mutex
+                 <<std::setw(20)<<atomic
+                 <<std::setw(20)<<sharded<<std::endl;
+        if(t==maxThreads)
+            break;
+    }
+    return 0;
+}
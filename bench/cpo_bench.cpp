@@ -0,0 +1,419 @@
+/*
+    统一的并发基准：对项目中的每种并发原语在1..N个线程下做竞争扫描，输出吞吐量和延迟分布
+
+    用法：cpo_bench [选项]
+        --threads=N         最大线程数，线程数从1开始按2的倍数增加（默认硬件线程数）
+        --ops=N             每个线程的操作次数（默认200000）
+        --read-ratio=R      map基准中读操作的比例，0~1（默认0.9）
+        --payload=B         map基准中value的字节数（默认64）
+        --keys=N            map基准中的key数量（默认10000）
+        --bench=a,b,...     只运行指定的基准（默认全部）：
+                            counter map mpmc spsc lockfree pool async std_async
+        --format=F          table（默认）、csv或json，csv/json可以直接保存下来和其他版本的结果对比
+
+    每次操作的延迟用steady_clock测量（包含约20ns的计时开销），记录到每个线程自己的HdrHistogram中，
+    结束后合并，报告p50/p99/p99.9/max
+    pool：从提交到任务开始执行的延迟；async：从pool_async提交到then续体开始执行的延迟；
+    std_async：std::async(launch::async)从提交到get()返回的往返延迟
+*/
+#include<iostream>
+#include<iomanip>
+#include<atomic>
+#include<chrono>
+#include<cstdlib>
+#include<functional>
+#include<future>
+#include<memory>
+#include<random>
+#include<sstream>
+#include<string>
+#include<thread>
+#include<vector>
+#include"hdr_histogram.h"
+#include"sharded_counter.h"
+#include"concurrent_map.h"
+#include"mpmc_queue.h"
+#include"spsc_channel.h"
+#include"lockfree_queue.h"
+#include"thread_pool.h"
+#include"pool_future.h"
+
+struct Options{
+    size_t max_threads=std::thread::hardware_concurrency();
+    uint64_t ops=200000;
+    double read_ratio=0.9;
+    size_t payload=64;
+    size_t keys=10000;
+    std::string format="table";
+    std::vector<std::string>benches{"counter","map","mpmc","spsc","lockfree","pool","async","std_async"};
+};
+
+struct Result{
+    std::string bench;
+    size_t threads;
+    uint64_t ops;
+    double seconds;
+    HdrHistogram latency;
+};
+
+static uint64_t now_ns(){
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/*
+    启动threads个线程同时执行body(线程编号,本线程的直方图)，返回从同时开始到全部结束的秒数
+*/
+static double run_threads(size_t threads,std::vector<HdrHistogram>& hists,
+                          const std::function<void(size_t,HdrHistogram&)>& body){
+    hists.assign(threads,HdrHistogram());
+    std::atomic<size_t>ready{0};
+    std::atomic<bool>go{false};
+    std::vector<std::thread>workers;
+    for(size_t t=0;t<threads;++t){
+        workers.emplace_back([&,t]{
+            ready.fetch_add(1);
+            while(!go.load())
+                std::this_thread::yield();
+            body(t,hists[t]);
+        });
+    }
+    while(ready.load()<threads)
+        std::this_thread::yield();
+    uint64_t start=now_ns();
+    go.store(true);
+    for(std::thread& w:workers)
+        w.join();
+    return (now_ns()-start)/1e9;
+}
+
+static Result finish(const std::string& name,size_t threads,uint64_t ops,double seconds,std::vector<HdrHistogram>& hists){
+    Result r{name,threads,ops,seconds,HdrHistogram()};
+    for(HdrHistogram& h:hists)
+        r.latency.merge(h);
+    return r;
+}
+
+static Result bench_counter(size_t threads,const Options& opt){
+    ShardedCounter counter;
+    std::vector<HdrHistogram>hists;
+    double s=run_threads(threads,hists,[&](size_t,HdrHistogram& h){
+        for(uint64_t i=0;i<opt.ops;++i){
+            uint64_t t0=now_ns();
+            counter.increment();
+            h.record(now_ns()-t0);
+        }
+    });
+    return finish("counter",threads,threads*opt.ops,s,hists);
+}
+
+static Result bench_map(size_t threads,const Options& opt){
+    ConcurrentHashMap<std::string,std::string,StringHash,std::equal_to<>>map;
+    std::vector<std::string>keys;
+    for(size_t k=0;k<opt.keys;++k){
+        keys.push_back("key"+std::to_string(k));
+        map.insert_or_assign(keys.back(),std::string(opt.payload,'v'));
+    }
+    std::vector<HdrHistogram>hists;
+    std::atomic<size_t>sink_value{0};
+    double s=run_threads(threads,hists,[&](size_t t,HdrHistogram& h){
+        std::mt19937_64 rng(t+1);
+        std::uniform_real_distribution<double>coin(0.0,1.0);
+        std::string value(opt.payload,static_cast<char>('a'+t%26));
+        size_t sink=0;
+        for(uint64_t i=0;i<opt.ops;++i){
+            const std::string& key=keys[rng()%keys.size()];
+            bool read=coin(rng)<opt.read_ratio;
+            uint64_t t0=now_ns();
+            if(read)
+                map.visit(key,[&sink](const std::string& v){sink+=v.size();});
+            else
+                map.insert_or_assign(key,value);
+            h.record(now_ns()-t0);
+        }
+        sink_value.fetch_add(sink,std::memory_order_relaxed);//防止读操作被优化掉
+    });
+    return finish("map",threads,threads*opt.ops,s,hists);
+}
+
+/*
+    队列基准：一半线程生产、一半线程消费（只有1个线程时同一个线程交替入队出队）
+    每个生产者入队ops个元素，记录每次入队和出队（包括等待）的延迟
+*/
+template<class Push,class TryPop>
+static Result bench_queue(const std::string& name,size_t threads,const Options& opt,Push push,TryPop try_pop){
+    std::vector<HdrHistogram>hists;
+    if(threads==1){
+        double s=run_threads(1,hists,[&](size_t,HdrHistogram& h){
+            uint64_t v;
+            for(uint64_t i=0;i<opt.ops;++i){
+                uint64_t t0=now_ns();
+                push(i);
+                uint64_t t1=now_ns();
+                try_pop(v);
+                uint64_t t2=now_ns();
+                h.record(t1-t0);
+                h.record(t2-t1);
+            }
+        });
+        return finish(name,1,opt.ops,s,hists);
+    }
+    size_t producers=threads/2;
+    uint64_t total=producers*opt.ops;
+    std::atomic<uint64_t>consumed{0};
+    double s=run_threads(threads,hists,[&](size_t t,HdrHistogram& h){
+        if(t<producers){
+            for(uint64_t i=0;i<opt.ops;++i){
+                uint64_t t0=now_ns();
+                push(i);
+                h.record(now_ns()-t0);
+            }
+            return;
+        }
+        uint64_t v;
+        while(consumed.load(std::memory_order_relaxed)<total){
+            uint64_t t0=now_ns();
+            if(try_pop(v)){
+                h.record(now_ns()-t0);
+                consumed.fetch_add(1,std::memory_order_relaxed);
+            }
+        }
+    });
+    return finish(name,threads,total,s,hists);
+}
+
+static Result bench_mpmc(size_t threads,const Options& opt){
+    MPMCQueue<uint64_t>queue(1024);
+    return bench_queue("mpmc",threads,opt,
+        [&](uint64_t v){queue.push(v);},
+        [&](uint64_t& v){return queue.try_pop(v);});
+}
+
+static Result bench_lockfree(size_t threads,const Options& opt){
+    LockFreeQueue<uint64_t>queue;
+    return bench_queue("lockfree",threads,opt,
+        [&](uint64_t v){queue.Enqueue(v);},
+        [&](uint64_t& v){return queue.try_dequeue(v);});
+}
+
+//SPSC通道只允许一对一：threads个线程组成threads/2个互不相关的生产者/消费者对（1个线程时自己交替入队出队）
+static Result bench_spsc(size_t threads,const Options& opt){
+    if(threads==1){
+        SPSCChannel<uint64_t>ch(1024);
+        return bench_queue("spsc",1,opt,
+            [&](uint64_t v){ch.push(v);},
+            [&](uint64_t& v){return ch.try_pop(v);});
+    }
+    size_t pairs=threads/2;
+    std::vector<std::unique_ptr<SPSCChannel<uint64_t>>>channels;
+    for(size_t p=0;p<pairs;++p)
+        channels.emplace_back(new SPSCChannel<uint64_t>(1024));
+    std::vector<HdrHistogram>hists;
+    double s=run_threads(pairs*2,hists,[&](size_t t,HdrHistogram& h){
+        SPSCChannel<uint64_t>& ch=*channels[t/2];
+        if(t%2==0){
+            for(uint64_t i=0;i<opt.ops;++i){
+                uint64_t t0=now_ns();
+                ch.push(i);
+                h.record(now_ns()-t0);
+            }
+        }else{
+            uint64_t v;
+            for(uint64_t i=0;i<opt.ops;++i){
+                uint64_t t0=now_ns();
+                ch.pop(v);
+                h.record(now_ns()-t0);
+            }
+        }
+    });
+    return finish("spsc",pairs*2,pairs*opt.ops,s,hists);
+}
+
+/*
+    线程池基准：threads个工作线程，一个外部线程用post提交ops*threads个任务，
+    每个任务记录从提交到开始执行的时间；工作线程第一次执行任务时分到自己的直方图
+*/
+struct PoolRecorder{
+    std::vector<HdrHistogram>hists;
+    std::atomic<size_t>next{0};
+    uint64_t generation;
+
+    explicit PoolRecorder(size_t workers):hists(workers){
+        static std::atomic<uint64_t>counter{0};
+        generation=counter.fetch_add(1)+1;
+    }
+
+    HdrHistogram& mine(){
+        static thread_local uint64_t gen=0;
+        static thread_local HdrHistogram* hist=nullptr;
+        if(gen!=generation){
+            gen=generation;
+            hist=&hists[next.fetch_add(1)];
+        }
+        return *hist;
+    }
+};
+
+static Result bench_pool(size_t threads,const Options& opt){
+    uint64_t total=threads*opt.ops;
+    PoolRecorder rec(threads);
+    std::atomic<uint64_t>done{0};
+    uint64_t start=now_ns();
+    {
+        ThreadPool pool(threads);
+        for(uint64_t i=0;i<total;++i){
+            uint64_t submitted=now_ns();
+            pool.post([&rec,&done,submitted]{
+                rec.mine().record(now_ns()-submitted);
+                done.fetch_add(1,std::memory_order_relaxed);
+            });
+        }
+        while(done.load(std::memory_order_relaxed)<total)
+            std::this_thread::yield();
+    }
+    double s=(now_ns()-start)/1e9;
+    return finish("pool",threads,total,s,rec.hists);
+}
+
+static Result bench_async(size_t threads,const Options& opt){
+    uint64_t total=threads*opt.ops/10;//每个操作包括两次调度和一个共享状态，比pool基准重得多
+    if(total==0)
+        total=1;
+    PoolRecorder rec(threads);
+    std::atomic<uint64_t>done{0};
+    uint64_t start=now_ns();
+    {
+        ThreadPool pool(threads);
+        for(uint64_t i=0;i<total;++i){
+            uint64_t submitted=now_ns();
+            pool_async(pool,[i]{return i;}).then([&rec,&done,submitted](uint64_t){
+                rec.mine().record(now_ns()-submitted);
+                done.fetch_add(1,std::memory_order_relaxed);
+            });
+        }
+        while(done.load(std::memory_order_relaxed)<total)
+            std::this_thread::yield();
+    }
+    double s=(now_ns()-start)/1e9;
+    return finish("async",threads,total,s,rec.hists);
+}
+
+static Result bench_std_async(size_t threads,const Options& opt){
+    uint64_t per_thread=opt.ops/100;//每次std::async都会创建一个线程
+    if(per_thread==0)
+        per_thread=1;
+    std::vector<HdrHistogram>hists;
+    double s=run_threads(threads,hists,[&](size_t,HdrHistogram& h){
+        for(uint64_t i=0;i<per_thread;++i){
+            uint64_t t0=now_ns();
+            std::async(std::launch::async,[i]{return i;}).get();
+            h.record(now_ns()-t0);
+        }
+    });
+    return finish("std_async",threads,threads*per_thread,s,hists);
+}
+
+static void print(const std::vector<Result>& results,const Options& opt){
+    if(opt.format=="csv"){
+        std::cout<<"bench,threads,ops,seconds,ops_per_sec,p50_ns,p99_ns,p999_ns,max_ns,mean_ns,read_ratio,payload"<<std::endl;
+        for(const Result& r:results){
+            std::cout<<r.bench<<','<<r.threads<<','<<r.ops<<','<<r.seconds<<','<<r.ops/r.seconds<<','
+                     <<r.latency.percentile(50)<<','<<r.latency.percentile(99)<<','<<r.latency.percentile(99.9)<<','
+                     <<r.latency.max()<<','<<r.latency.mean()<<','<<opt.read_ratio<<','<<opt.payload<<std::endl;
+        }
+        return;
+    }
+    if(opt.format=="json"){
+        std::cout<<"{\"read_ratio\":"<<opt.read_ratio<<",\"payload\":"<<opt.payload<<",\"keys\":"<<opt.keys
+                 <<",\"ops\":"<<opt.ops<<",\"results\":["<<std::endl;
+        for(size_t i=0;i<results.size();++i){
+            const Result& r=results[i];
+            std::cout<<"  {\"bench\":\""<<r.bench<<"\",\"threads\":"<<r.threads<<",\"ops\":"<<r.ops
+                     <<",\"seconds\":"<<r.seconds<<",\"ops_per_sec\":"<<r.ops/r.seconds
+                     <<",\"p50_ns\":"<<r.latency.percentile(50)<<",\"p99_ns\":"<<r.latency.percentile(99)
+                     <<",\"p999_ns\":"<<r.latency.percentile(99.9)<<",\"max_ns\":"<<r.latency.max()
+                     <<",\"mean_ns\":"<<r.latency.mean()<<"}"<<(i+1<results.size()?",":"")<<std::endl;
+        }
+        std::cout<<"]}"<<std::endl;
+        return;
+    }
+    std::cout<<std::left<<std::setw(11)<<"bench"<<std::setw(9)<<"threads"<<std::setw(16)<<"ops/s"
+             <<std::setw(10)<<"p50(ns)"<<std::setw(10)<<"p99(ns)"<<std::setw(11)<<"p99.9(ns)"<<std::setw(12)<<"max(ns)"<<std::endl;
+    for(const Result& r:results){
+        std::cout<<std::left<<std::setw(11)<<r.bench<<std::setw(9)<<r.threads
+                 <<std::setw(16)<<std::fixed<<std::setprecision(0)<<r.ops/r.seconds
+                 <<std::setw(10)<<r.latency.percentile(50)<<std::setw(10)<<r.latency.percentile(99)
+                 <<std::setw(11)<<r.latency.percentile(99.9)<<std::setw(12)<<r.latency.max()<<std::endl;
+    }
+}
+
+static bool parse(int argc,char** argv,Options& opt){
+    for(int i=1;i<argc;++i){
+        std::string arg=argv[i];
+        size_t eq=arg.find('=');
+        std::string key=arg.substr(0,eq);
+        std::string value=eq==std::string::npos?"":arg.substr(eq+1);
+        if(key=="--threads")
+            opt.max_threads=std::strtoul(value.c_str(),nullptr,10);
+        else if(key=="--ops")
+            opt.ops=std::strtoull(value.c_str(),nullptr,10);
+        else if(key=="--read-ratio")
+            opt.read_ratio=std::atof(value.c_str());
+        else if(key=="--payload")
+            opt.payload=std::strtoul(value.c_str(),nullptr,10);
+        else if(key=="--keys")
+            opt.keys=std::strtoul(value.c_str(),nullptr,10);
+        else if(key=="--format")
+            opt.format=value;
+        else if(key=="--bench"){
+            opt.benches.clear();
+            std::stringstream ss(value);
+            std::string name;
+            while(std::getline(ss,name,','))
+                opt.benches.push_back(name);
+        }else{
+            std::cerr<<"unknown option: "<<arg<<std::endl;
+            return false;
+        }
+    }
+    if(opt.max_threads==0)
+        opt.max_threads=1;
+    if(opt.keys==0)
+        opt.keys=1;
+    return opt.format=="table"||opt.format=="csv"||opt.format=="json";
+}
+
+int main(int argc,char** argv){
+    Options opt;
+    if(!parse(argc,argv,opt)){
+        std::cerr<<"usage: cpo_bench [--threads=N] [--ops=N] [--read-ratio=R] [--payload=B] [--keys=N]"
+                   " [--bench=a,b,...] [--format=table|csv|json]"<<std::endl;
+        return 1;
+    }
+    using Bench=Result(*)(size_t,const Options&);
+    const std::pair<const char*,Bench>all[]={
+        {"counter",bench_counter},{"map",bench_map},{"mpmc",bench_mpmc},{"spsc",bench_spsc},
+        {"lockfree",bench_lockfree},{"pool",bench_pool},{"async",bench_async},{"std_async",bench_std_async},
+    };
+    std::vector<Result>results;
+    for(const std::string& name:opt.benches){
+        Bench fn=nullptr;
+        for(const auto& b:all){
+            if(name==b.first)
+                fn=b.second;
+        }
+        if(!fn){
+            std::cerr<<"unknown bench: "<<name<<std::endl;
+            return 1;
+        }
+        for(size_t t=1;;t*=2){
+            if(t>opt.max_threads)
+                t=opt.max_threads;
+            results.push_back(fn(t,opt));
+            if(t==opt.max_threads)
+                break;
+        }
+    }
+    print(results,opt);
+    return 0;
+}
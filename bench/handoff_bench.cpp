@@ -0,0 +1,108 @@
+/*
+    交接延迟基准：对比三种WaitPolicy（blocking / adaptive / spinning）下，
+    一个元素从生产者交给正在等待的消费者要多久
+    用法：handoff_bench [每组交接次数] [最大间隔(微秒)]
+    * pool：外部线程post一个任务，记录从post到任务开始执行的时间（工作线程正在等待任务）
+    * mpmc：生产者push一个时间戳，消费者阻塞在pop上，记录从push到pop返回的时间
+    * spsc：同上，换成SPSCChannel
+    每次交接之间生产者先忙等一个间隔（0、1、10、100微秒……直到最大间隔），间隔越长，消费者越可能已经从自旋进入睡眠；
+    输出每组的p50/p99/p99.9/max（纳秒）
+*/
+#include<iostream>
+#include<iomanip>
+#include<atomic>
+#include<chrono>
+#include<cstdlib>
+#include<string>
+#include<thread>
+#include"hdr_histogram.h"
+#include"thread_pool.h"
+#include"mpmc_queue.h"
+#include"spsc_channel.h"
+
+static uint64_t now_ns(){
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+//忙等us微秒，不让出CPU，模拟生产者两次交接之间在做别的工作
+static void busy_wait(uint64_t us){
+    uint64_t until=now_ns()+us*1000;
+    while(now_ns()<until)
+        cpu_relax();
+}
+
+static void pool_handoff(const WaitPolicy& policy,uint64_t gap,int count,HdrHistogram& hist){
+    std::atomic<int>done{0};
+    ThreadPool pool(1,ThreadPool::Mode::SharedQueue,policy);
+    for(int i=0;i<count;++i){
+        busy_wait(gap);
+        uint64_t submitted=now_ns();
+        pool.post([&hist,&done,submitted]{
+            hist.record(now_ns()-submitted);//只有一个工作线程，直方图只有一个写者
+            done.fetch_add(1,std::memory_order_release);
+        });
+        while(done.load(std::memory_order_acquire)<=i)//上一次交接完成后再开始下一次
+            std::this_thread::yield();
+    }
+}
+
+template<class Queue>
+static void queue_handoff(Queue& queue,Queue& ack,uint64_t gap,int count,HdrHistogram& hist){
+    std::thread consumer([&]{
+        for(int i=0;i<count;++i){
+            uint64_t submitted=0;
+            queue.pop(submitted);
+            hist.record(now_ns()-submitted);
+            ack.push(uint64_t(0));
+        }
+    });
+    for(int i=0;i<count;++i){
+        busy_wait(gap);
+        queue.push(now_ns());
+        uint64_t dummy;
+        ack.pop(dummy);
+    }
+    consumer.join();
+}
+
+static void row(const char* kind,const char* policy,uint64_t gap,const HdrHistogram& h){
+    std::cout<<std::left<<std::setw(7)<<kind<<std::setw(11)<<policy<<std::setw(10)<<gap
+             <<std::setw(10)<<h.percentile(50)<<std::setw(10)<<h.percentile(99)
+             <<std::setw(11)<<h.percentile(99.9)<<std::setw(12)<<h.max()<<std::endl;
+}
+
+int main(int argc,char** argv){
+    int count=argc>1?std::atoi(argv[1]):2000;
+    uint64_t maxGap=argc>2?std::strtoull(argv[2],nullptr,10):100;
+    const std::pair<const char*,WaitPolicy>policies[]={
+        {"blocking",WaitPolicy::blocking()},
+        {"adaptive",WaitPolicy::adaptive()},
+        {"spinning",WaitPolicy::spinning()},
+    };
+
+    std::cout<<std::left<<std::setw(7)<<"kind"<<std::setw(11)<<"policy"<<std::setw(10)<<"gap(us)"
+             <<std::setw(10)<<"p50(ns)"<<std::setw(10)<<"p99(ns)"<<std::setw(11)<<"p99.9(ns)"<<std::setw(12)<<"max(ns)"<<std::endl;
+    for(uint64_t gap=0;;gap=gap==0?1:gap*10){
+        if(gap>maxGap)
+            break;
+        for(const auto& p:policies){
+            HdrHistogram h;
+            pool_handoff(p.second,gap,count,h);
+            row("pool",p.first,gap,h);
+        }
+        for(const auto& p:policies){
+            HdrHistogram h;
+            MPMCQueue<uint64_t>queue(64,p.second),ack(64,p.second);
+            queue_handoff(queue,ack,gap,count,h);
+            row("mpmc",p.first,gap,h);
+        }
+        for(const auto& p:policies){
+            HdrHistogram h;
+            SPSCChannel<uint64_t>queue(64,p.second),ack(64,p.second);
+            queue_handoff(queue,ack,gap,count,h);
+            row("spsc",p.first,gap,h);
+        }
+    }
+    return 0;
+}
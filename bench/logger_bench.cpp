@@ -0,0 +1,84 @@
+/*
+    日志基准：对比在调用线程里加锁格式化输出（原来的std::cout<<写法）和AsyncLogger
+    用法：logger_bench [最大线程数] [每个线程的记录数]
+    输出写到/dev/null，只比较调用线程的开销：每个线程记录count条，每64条计一次时，
+    报告每条记录的平均耗时和（按64条一组计算的）p99，单位纳秒
+*/
+#include<iostream>
+#include<iomanip>
+#include<atomic>
+#include<chrono>
+#include<cstdlib>
+#include<fstream>
+#include<mutex>
+#include<thread>
+#include<vector>
+#include"async_logger.h"
+#include"hdr_histogram.h"
+
+static uint64_t now_ns(){
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+constexpr int group=64;
+
+template<class Log>
+static void run(const char* name,size_t threads,int count,Log log){
+    std::vector<HdrHistogram>hists(threads);
+    std::atomic<bool>go{false};
+    std::vector<std::thread>workers;
+    for(size_t t=0;t<threads;++t){
+        workers.emplace_back([&,t]{
+            while(!go.load())
+                std::this_thread::yield();
+            for(int i=0;i<count;i+=group){
+                uint64_t start=now_ns();
+                for(int k=0;k<group;++k)
+                    log(t,i+k);
+                hists[t].record((now_ns()-start)/group);
+            }
+        });
+    }
+    uint64_t start=now_ns();
+    go.store(true);
+    for(std::thread& w:workers)
+        w.join();
+    uint64_t elapsed=now_ns()-start;
+    HdrHistogram all;
+    for(const HdrHistogram& h:hists)
+        all.merge(h);
+    std::cout<<std::left<<std::setw(10)<<name<<std::setw(10)<<threads
+             <<std::setw(14)<<elapsed/static_cast<uint64_t>(count)
+             <<std::setw(14)<<all.percentile(50)<<std::setw(14)<<all.percentile(99)<<std::endl;
+}
+
+int main(int argc,char** argv){
+    size_t maxThreads=argc>1?std::strtoul(argv[1],nullptr,10):std::thread::hardware_concurrency();
+    int count=argc>2?std::atoi(argv[2]):200000;
+    if(maxThreads==0)
+        maxThreads=1;
+    count=(count+group-1)/group*group;
+    std::ofstream null("/dev/null");
+
+    std::cout<<std::left<<std::setw(10)<<"logger"<<std::setw(10)<<"threads"<<std::setw(14)<<"wall(ns/rec)"
+             <<std::setw(14)<<"p50(ns/rec)"<<std::setw(14)<<"p99(ns/rec)"<<std::endl;
+    for(size_t t=1;;t*=2){
+        if(t>maxThreads)
+            t=maxThreads;
+        std::mutex mutex;
+        run("locked",t,count,[&](size_t id,int i){
+            std::lock_guard<std::mutex>lock(mutex);
+            null<<"worker "<<id<<" iteration "<<i<<" value "<<3.5<<std::endl;
+        });
+        {
+            AsyncLogger logger(null);
+            run("async",t,count,[&](size_t id,int i){
+                logger.log("worker {} iteration {} value {}",id,i,3.5);
+            });
+        }
+        if(t==maxThreads)
+            break;
+    }
+    return 0;
+}
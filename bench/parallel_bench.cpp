@@ -0,0 +1,71 @@
+/*
+    并行算法基准：对比parallel_for/parallel_reduce/parallel_sort和串行的std::for_each/std::accumulate/std::sort
+    用法：parallel_bench [线程数] [最大元素数]
+    元素数从10^4开始按10倍增加到最大元素数，输出每种算法的耗时（毫秒）和加速比
+*/
+#include<iostream>
+#include<iomanip>
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<cstdlib>
+#include<numeric>
+#include<random>
+#include<vector>
+#include"parallel_algorithms.h"
+
+template<class F>
+static double time_ms(F&& f){
+    auto start=std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double,std::milli>elapsed=std::chrono::steady_clock::now()-start;
+    return elapsed.count();
+}
+
+static void row(const char* name,size_t n,double serial,double parallel){
+    std::cout<<std::left<<std::setw(10)<<name
+             <<std::setw(12)<<n
+             <<std::setw(14)<<std::fixed<<std::setprecision(3)<<serial
+             <<std::setw(14)<<parallel
+             <<std::setw(10)<<std::setprecision(2)<<serial/parallel<<std::endl;
+}
+
+int main(int argc,char** argv){
+    size_t threads=argc>1?std::strtoul(argv[1],nullptr,10):std::thread::hardware_concurrency();
+    size_t maxSize=argc>2?std::strtoul(argv[2],nullptr,10):10000000;
+    if(threads==0)
+        threads=1;
+    ThreadPool pool(threads);
+
+    std::cout<<std::left<<std::setw(10)<<"algorithm"
+             <<std::setw(12)<<"size"
+             <<std::setw(14)<<"serial(ms)"
+             <<std::setw(14)<<"parallel(ms)"
+             <<std::setw(10)<<"speedup"<<std::endl;
+    std::mt19937_64 rng(42);
+    for(size_t n=10000;n<=maxSize;n*=10){
+        std::vector<double>data(n);
+        for(double& d:data)
+            d=static_cast<double>(rng()%1000000);
+        auto work=[](double& d){d=std::sqrt(d)*1.0001+1.0;};
+
+        std::vector<double>a=data,b=data;
+        double serial=time_ms([&]{std::for_each(a.begin(),a.end(),work);});
+        double parallel=time_ms([&]{parallel_for(pool,b.begin(),b.end(),work);});
+        row("for",n,serial,parallel);
+
+        volatile double sink=0;
+        serial=time_ms([&]{sink=std::accumulate(data.begin(),data.end(),0.0);});
+        parallel=time_ms([&]{sink=parallel_reduce(pool,data.begin(),data.end(),0.0);});
+        row("reduce",n,serial,parallel);
+
+        a=data;
+        b=data;
+        serial=time_ms([&]{std::sort(a.begin(),a.end());});
+        parallel=time_ms([&]{parallel_sort(pool,b.begin(),b.end());});
+        if(a!=b)
+            std::cerr<<"parallel_sort result mismatch"<<std::endl;
+        row("sort",n,serial,parallel);
+    }
+    return 0;
+}
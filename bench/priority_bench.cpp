@@ -0,0 +1,104 @@
+/*
+    优先级基准：后台线程不断提交低优先级的长任务让线程池一直饱和，
+    主线程每隔一段时间提交一个短的高优先级任务，记录从提交到开始执行的时间
+    用法：priority_bench [高优先级任务数] [线程数]
+    * fifo：高优先级任务和后台任务进入同一个通道（Low），要排在所有已经积压的任务后面，相当于没有优先级的线程池
+    * high：post(Priority::High, ...)
+    * deadline：post_deadline(now+1ms, ...)
+    同时输出低优先级任务的完成数，说明低优先级任务没有被饿死
+*/
+#include<iostream>
+#include<iomanip>
+#include<atomic>
+#include<chrono>
+#include<cstdlib>
+#include<mutex>
+#include<thread>
+#include"hdr_histogram.h"
+#include"thread_pool.h"
+
+static uint64_t now_ns(){
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static void busy_wait(uint64_t us){
+    uint64_t until=now_ns()+us*1000;
+    while(now_ns()<until)
+        cpu_relax();
+}
+
+enum class Submit{Fifo,High,Deadline};
+
+static void run(const char* name,Submit submit,int count,size_t threads){
+    constexpr int backlog=256;//低优先级任务的积压数量
+    constexpr uint64_t low_us=20;
+    HdrHistogram hist;
+    std::atomic<int>in_flight{0};
+    std::atomic<uint64_t>low_done{0};
+    std::atomic<int>high_done{0};
+    std::atomic<bool>stop{false};
+    {
+        ThreadPool pool(threads);
+        std::thread flood([&]{
+            while(!stop.load(std::memory_order_relaxed)){
+                if(in_flight.load(std::memory_order_relaxed)>=backlog){
+                    std::this_thread::yield();
+                    continue;
+                }
+                in_flight.fetch_add(1,std::memory_order_relaxed);
+                pool.post(Priority::Low,[&]{
+                    busy_wait(low_us);
+                    low_done.fetch_add(1,std::memory_order_relaxed);
+                    in_flight.fetch_sub(1,std::memory_order_relaxed);
+                });
+            }
+        });
+        while(in_flight.load()<backlog)//先让积压达到稳定
+            std::this_thread::yield();
+
+        uint64_t start=now_ns();
+        std::mutex hist_mutex;//多个工作线程都会记录，直方图只允许一个写者
+        for(int i=0;i<count;++i){
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            uint64_t submitted=now_ns();
+            auto task=[&,submitted]{
+                uint64_t latency=now_ns()-submitted;
+                {
+                    std::lock_guard<std::mutex>lock(hist_mutex);
+                    hist.record(latency);
+                }
+                high_done.fetch_add(1,std::memory_order_release);
+            };
+            switch(submit){
+                case Submit::Fifo:pool.post(Priority::Low,task);break;
+                case Submit::High:pool.post(Priority::High,task);break;
+                case Submit::Deadline:
+                    pool.post_deadline(std::chrono::steady_clock::now()+std::chrono::milliseconds(1),task);
+                    break;
+            }
+        }
+        while(high_done.load(std::memory_order_acquire)<count)
+            std::this_thread::yield();
+        double seconds=(now_ns()-start)/1e9;
+        uint64_t low=low_done.load();
+        stop=true;
+        flood.join();
+        std::cout<<std::left<<std::setw(10)<<name<<std::setw(12)<<hist.percentile(50)<<std::setw(12)<<hist.percentile(99)
+                 <<std::setw(12)<<hist.max()<<std::setw(14)<<static_cast<uint64_t>(low/seconds)<<std::endl;
+    }//析构时执行完剩下的积压任务
+}
+
+int main(int argc,char** argv){
+    int count=argc>1?std::atoi(argv[1]):2000;
+    size_t threads=argc>2?std::strtoul(argv[2],nullptr,10):std::thread::hardware_concurrency();
+    if(threads==0)
+        threads=1;
+    std::cout<<"threads="<<threads<<" high tasks="<<count<<std::endl;
+    std::cout<<std::left<<std::setw(10)<<"submit"<<std::setw(12)<<"p50(ns)"<<std::setw(12)<<"p99(ns)"
+             <<std::setw(12)<<"max(ns)"<<std::setw(14)<<"low tasks/s"<<std::endl;
+    run("fifo",Submit::Fifo,count,threads);
+    run("high",Submit::High,count,threads);
+    run("deadline",Submit::Deadline,count,threads);
+    return 0;
+}
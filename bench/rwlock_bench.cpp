@@ -0,0 +1,84 @@
+/*
+    读写锁吞吐量基准：对比std::shared_mutex和DistributedSharedMutex
+    负载：所有线程共用一把锁保护的一小块数据，每次操作按比例选择读（共享锁，读出几个值求和）或写（独占锁，修改这些值）
+    用法：rwlock_bench [最大线程数] [每个线程的操作数]
+    读写比例为95/5和99/1两组，线程数从1开始按2的倍数增加到最大线程数，输出每秒完成的操作数
+*/
+#include<iostream>
+#include<iomanip>
+#include<atomic>
+#include<chrono>
+#include<cstdint>
+#include<cstdlib>
+#include<mutex>
+#include<shared_mutex>
+#include<thread>
+#include<vector>
+#include"distributed_shared_mutex.h"
+
+template<typename Lock>
+struct Protected{
+    Lock lock;
+    uint64_t values[8]={};
+};
+
+template<typename Lock>
+static double run(size_t threads,long iterations,unsigned readPercent){
+    Protected<Lock>data;
+    std::atomic<bool>go{false};
+    std::atomic<uint64_t>sink{0};
+    std::vector<std::thread>workers;
+    for(size_t t=0;t<threads;++t){
+        workers.emplace_back([&,t]{
+            uint64_t rng=0x9e3779b97f4a7c15ull*(t+1);//xorshift，每个线程自己的随机数
+            uint64_t sum=0;
+            while(!go.load())
+                std::this_thread::yield();
+            for(long i=0;i<iterations;++i){
+                rng^=rng<<13;
+                rng^=rng>>7;
+                rng^=rng<<17;
+                if(rng%100<readPercent){
+                    std::shared_lock<Lock>lock(data.lock);
+                    for(uint64_t v:data.values)
+                        sum+=v;
+                }else{
+                    std::unique_lock<Lock>lock(data.lock);
+                    for(uint64_t& v:data.values)
+                        ++v;
+                }
+            }
+            sink.fetch_add(sum,std::memory_order_relaxed);
+        });
+    }
+    auto start=std::chrono::steady_clock::now();
+    go.store(true);
+    for(std::thread& w:workers)
+        w.join();
+    std::chrono::duration<double>elapsed=std::chrono::steady_clock::now()-start;
+    return static_cast<double>(threads)*iterations/elapsed.count();
+}
+
+int main(int argc,char** argv){
+    size_t maxThreads=argc>1?std::strtoul(argv[1],nullptr,10):std::thread::hardware_concurrency();
+    long iterations=argc>2?std::atol(argv[2]):1000000;
+    if(maxThreads==0)
+        maxThreads=1;
+
+    std::cout<<std::left<<std::setw(10)<<"read%"<<std::setw(10)<<"threads"
+             <<std::setw(22)<<"shared_mutex(ops/s)"
+             <<std::setw(22)<<"distributed(ops/s)"<<std::endl;
+    for(unsigned readPercent:{95u,99u}){
+        for(size_t t=1;;t*=2){
+            if(t>maxThreads)
+                t=maxThreads;
+            double shared=run<std::shared_mutex>(t,iterations,readPercent);
+            double distributed=run<DistributedSharedMutex>(t,iterations,readPercent);
+            std::cout<<std::left<<std::setw(10)<<readPercent<<std::setw(10)<<t<<std::fixed<<std::setprecision(0)
+                     <<std::setw(22)<<shared<<std::setw(22)<<distributed<<std::endl;
+            if(t==maxThreads)
+                break;
+        }
+    }
+    return 0;
+}
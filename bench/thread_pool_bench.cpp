@@ -0,0 +1,107 @@
+/*
+    ThreadPool吞吐量基准：对比SharedQueue和WorkStealing两种调度模式
+    负载：外部线程提交roots个根任务，每个根任务在工作线程内部再提交fanout个很短的子任务
+    用法：thread_pool_bench [最大线程数] [根任务数] [每个根任务的子任务数]
+    线程数从1开始按2的倍数增加到最大线程数，输出每秒完成的任务数
+    第二部分对比外部线程用enqueue、post、enqueue_bulk三种方式提交大量极短任务的吞吐量
+*/
+#include<iostream>
+#include<iomanip>
+#include<atomic>
+#include<chrono>
+#include<cstdlib>
+#include<string>
+#include<vector>
+#include<algorithm>
+#include"thread_pool.h"
+
+static void spin(int iterations){
+    volatile int sink=0;
+    for(int i=0;i<iterations;++i)
+        sink=sink+i;
+}
+
+static double run(size_t threads,ThreadPool::Mode mode,int roots,int fanout){
+    std::atomic<long>done{0};
+    const long total=static_cast<long>(roots)*(fanout+1);
+    auto start=std::chrono::steady_clock::now();
+    {
+        ThreadPool pool(threads,mode);
+        for(int r=0;r<roots;++r){
+            pool.enqueue([&pool,&done,fanout]{
+                for(int c=0;c<fanout;++c){
+                    pool.enqueue([&done]{
+                        spin(50);
+                        done.fetch_add(1,std::memory_order_relaxed);
+                    });
+                }
+                done.fetch_add(1,std::memory_order_relaxed);
+            });
+        }
+        while(done.load(std::memory_order_relaxed)<total)
+            std::this_thread::yield();
+    }
+    std::chrono::duration<double>elapsed=std::chrono::steady_clock::now()-start;
+    return total/elapsed.count();
+}
+
+enum class Submit{Enqueue,Post,Bulk};
+
+static double submit(size_t threads,Submit how,long count){
+    std::atomic<long>done{0};
+    auto start=std::chrono::steady_clock::now();
+    {
+        ThreadPool pool(threads);
+        auto job=[&done]{done.fetch_add(1,std::memory_order_relaxed);};
+        if(how==Submit::Enqueue){
+            for(long i=0;i<count;++i)
+                pool.enqueue(job);
+        }else if(how==Submit::Post){
+            for(long i=0;i<count;++i)
+                pool.post(job);
+        }else{
+            const long batchSize=64;
+            std::vector<decltype(job)>batch(batchSize,job);
+            for(long i=0;i<count;i+=batchSize)
+                pool.enqueue_bulk(batch.begin(),batch.begin()+std::min(batchSize,count-i));
+        }
+        while(done.load(std::memory_order_relaxed)<count)
+            std::this_thread::yield();
+    }
+    std::chrono::duration<double>elapsed=std::chrono::steady_clock::now()-start;
+    return count/elapsed.count();
+}
+
+int main(int argc,char** argv){
+    size_t maxThreads=argc>1?std::strtoul(argv[1],nullptr,10):std::thread::hardware_concurrency();
+    int roots=argc>2?std::atoi(argv[2]):200;
+    int fanout=argc>3?std::atoi(argv[3]):500;
+    if(maxThreads==0)
+        maxThreads=1;
+
+    std::cout<<std::left<<std::setw(10)<<"threads"
+             <<std::setw(20)<<"shared(tasks/s)"
+             <<std::setw(20)<<"stealing(tasks/s)"<<std::endl;
+    for(size_t t=1;;t*=2){
+        if(t>maxThreads)
+            t=maxThreads;
+        double shared=run(t,ThreadPool::Mode::SharedQueue,roots,fanout);
+        double stealing=run(t,ThreadPool::Mode::WorkStealing,roots,fanout);
+        std::cout<<std::left<<std::setw(10)<<t
+                 <<std::setw(20)<<std::fixed<<std::setprecision(0)<<shared
+                 <<std::setw(20)<<stealing<<std::endl;
+        if(t==maxThreads)
+            break;
+    }
+
+    const long count=static_cast<long>(roots)*fanout;
+    std::cout<<std::endl<<std::left<<std::setw(10)<<"threads"
+             <<std::setw(20)<<"enqueue(tasks/s)"
+             <<std::setw(20)<<"post(tasks/s)"
+             <<std::setw(20)<<"bulk(tasks/s)"<<std::endl;
+    std::cout<<std::left<<std::setw(10)<<maxThreads
+             <<std::setw(20)<<submit(maxThreads,Submit::Enqueue,count)
+             <<std::setw(20)<<submit(maxThreads,Submit::Post,count)
+             <<std::setw(20)<<submit(maxThreads,Submit::Bulk,count)<<std::endl;
+    return 0;
+}
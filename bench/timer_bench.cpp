@@ -0,0 +1,67 @@
+/*
+    定时器基准：一次提交大量schedule_after定时器（随机延迟），取消其中一部分，
+    输出每次插入和取消的平均耗时，以及到期任务开始执行时比预定时间晚了多少（p50/p99/max）
+    用法：timer_bench [定时器个数] [最大延迟(毫秒)] [取消的百分比]
+*/
+#include<iostream>
+#include<iomanip>
+#include<atomic>
+#include<chrono>
+#include<cstdlib>
+#include<mutex>
+#include<random>
+#include<thread>
+#include<vector>
+#include"hdr_histogram.h"
+#include"thread_pool.h"
+
+static uint64_t now_ns(){
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+int main(int argc,char** argv){
+    int count=argc>1?std::atoi(argv[1]):100000;
+    int maxDelay=argc>2?std::atoi(argv[2]):1000;
+    int cancelPercent=argc>3?std::atoi(argv[3]):50;
+    if(count<=0||maxDelay<=0)
+        return 1;
+
+    HdrHistogram lateness;
+    std::mutex mutex;//多个工作线程都会记录，直方图只允许一个写者
+    std::atomic<int>fired{0};
+    ThreadPool pool(std::max(1u,std::thread::hardware_concurrency()));
+    std::vector<ThreadPool::TimerHandle>handles;
+    handles.reserve(count);
+    std::mt19937 rng(42);
+
+    uint64_t start=now_ns();
+    for(int i=0;i<count;++i){
+        uint64_t delay=(rng()%static_cast<unsigned>(maxDelay)+1)*1000000ull;
+        uint64_t due=now_ns()+delay;
+        handles.push_back(pool.schedule_after(std::chrono::nanoseconds(delay),[&,due]{
+            uint64_t late=now_ns()-due;
+            {
+                std::lock_guard<std::mutex>lock(mutex);
+                lateness.record(late);
+            }
+            fired.fetch_add(1,std::memory_order_relaxed);
+        }));
+    }
+    uint64_t inserted=now_ns();
+    int cancelled=0;
+    for(int i=0;i<count;++i){
+        if(static_cast<int>(rng()%100)<cancelPercent&&pool.cancel(handles[i]))
+            ++cancelled;
+    }
+    uint64_t cancelEnd=now_ns();
+    while(fired.load()+cancelled<count)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    std::cout<<"timers="<<count<<" cancelled="<<cancelled<<" fired="<<fired.load()<<std::endl;
+    std::cout<<"insert(ns/op)="<<(inserted-start)/count
+             <<" cancel(ns/op)="<<(cancelEnd-inserted)/count<<std::endl;
+    std::cout<<"lateness(us) p50="<<lateness.percentile(50)/1000<<" p99="<<lateness.percentile(99)/1000
+             <<" max="<<lateness.max()/1000<<std::endl;
+    return 0;
+}
@@ -1,7 +1,12 @@
 #include<iostream>
+#include<atomic>
 #include<future>
 #include<thread>
 #include<chrono>
+#include<vector>
+#include<memory>
+#include<string>
+#include"pool_future.h"
 
 //模拟一个长时间运行的函数
 int longRunningFunction(int input){
@@ -18,6 +23,70 @@ int main(){
     //当需要longRunningFunction的结果时，使用std::future::get()获取
     int result=resultFuture.get();//这里会阻塞，直到结果可用
     std::cout<<"the result of longRunningFunction is:"<<result<<std::endl;
+
+    /*
+        PoolFuture：结果就绪时把后续步骤直接提交到线程池，不需要有线程在get()上等待
+        下面的fan-out/fan-in：8个平方计算并行执行，when_all收集结果后求和，再接一步格式化，
+        整个流水线只在最后调用一次get()
+    */
+    ThreadPool pool(4);
+    std::vector<PoolFuture<int>>squares;
+    for(int i=1;i<=8;++i){
+        squares.push_back(pool_async(pool,[](int x){return x*x;},i));
+    }
+    PoolFuture<std::string>report=when_all(std::move(squares))
+        .then([](std::vector<int>values){
+            int sum=0;
+            for(int v:values)
+                sum+=v;
+            return sum;
+        })
+        .then([](int sum){
+            return "sum of squares:"+std::to_string(sum);
+        });
+
+    //when_any：多个副本同时计算，使用最先完成的那个
+    std::vector<PoolFuture<int>>replicas;
+    for(int i=0;i<3;++i){
+        replicas.push_back(pool_async(pool,[i]{return 100+i;}));
+    }
+    PoolFuture<void>first=when_any(std::move(replicas)).then([](std::pair<size_t,int>winner){
+        std::cout<<"replica "<<winner.first<<" answered first:"<<winner.second<<std::endl;
+    });
+
+    /*
+        schedule_after：longRunningFunction中的sleep_for会占住一个线程什么也不做；
+        交给线程池的定时器后，等待期间不占用任何线程，到期后才把计算放入任务队列
+        schedule_every：周期任务，cancel之后不再触发
+        定时任务可能在get()返回之后才结束，不要按引用捕获局部变量：promise移动进回调，计数器用shared_ptr共享
+    */
+    PoolPromise<int>delayed(pool);
+    PoolFuture<int>delayedResult=delayed.get_future();
+    pool.schedule_after(std::chrono::milliseconds(500),[promise=std::move(delayed)]()mutable{
+        promise.set_value(4*4);
+    });
+    auto heartbeats=std::make_shared<std::atomic<int>>(0);
+    ThreadPool::TimerHandle heartbeat=pool.schedule_every(std::chrono::milliseconds(100),[heartbeats]{
+        heartbeats->fetch_add(1);
+    });
+
+    std::cout<<report.get()<<std::endl;
+    first.get();
+    std::cout<<"the delayed result is:"<<delayedResult.get()<<std::endl;
+    pool.cancel(heartbeat);
+    std::cout<<"heartbeats:"<<heartbeats->load()<<std::endl;
+
+    //promise在设置结果之前被销毁：get()不会永远阻塞，而是抛出broken_promise
+    PoolFuture<int>orphan;
+    {
+        PoolPromise<int>abandoned(pool);
+        orphan=abandoned.get_future();
+    }
+    try{
+        orphan.get();
+    }catch(const std::future_error& e){
+        std::cout<<"abandoned promise:"<<e.what()<<std::endl;
+    }
     return 0;
 
 }
\ No newline at end of file
@@ -0,0 +1,395 @@
+#pragma once
+#include<algorithm>
+#include<atomic>
+#include<chrono>
+#include<condition_variable>
+#include<cstddef>
+#include<cstdint>
+#include<cstdio>
+#include<cstring>
+#include<iostream>
+#include<memory>
+#include<mutex>
+#include<sstream>
+#include<string>
+#include<string_view>
+#include<thread>
+#include<type_traits>
+#include<vector>
+#if defined(__x86_64__)||defined(__i386__)
+#include<x86intrin.h>
+#endif
+
+/*
+    异步批量日志
+
+    在锁内std::cout<<：格式化、cout自己的锁和write系统调用全都算进了临界区。AsyncLogger把这些移到后台线程：
+    * 每个线程第一次记录时分配一个自己的环形字节缓冲区（单生产者单消费者，head/tail在不同的缓存行），
+      log()只把格式串指针、参数的二进制值和时间戳拷贝进去，然后一次release store发布，不加锁、不格式化、不分配内存
+    * 后台线程定期（flush_interval）收集所有缓冲区中的记录，按时间戳归并排序后格式化成一个大字符串，一次写入输出流
+    * 时间戳在发布之前读取：x86上是TSC（现代CPU的TSC在各核之间同步且恒定频率），其他平台是steady_clock；
+      后台每一轮只输出上一轮开始之前的记录，给正在写入的线程留出一个flush_interval的余量，因此不同线程的记录按时间戳有序
+    * 格式串用{}作为占位符，必须是字符串字面量（只保存指针）；参数可以是整数、浮点数、bool、字符、
+      字符串（const char*、std::string、std::string_view，内容会被拷贝），以及其他可以用<<输出的平凡可拷贝类型（例如std::thread::id）
+    * 缓冲区满时log()唤醒后台线程并让出CPU，直到有空间（不丢弃记录）；单条记录超过缓冲区的1/4时丢弃，dropped()返回丢弃的条数
+    * flush()等待调用之前的所有记录写出；析构时写出所有剩余记录。析构开始之后不能再调用log()
+*/
+
+namespace log_detail{
+
+inline uint64_t stamp(){
+#if defined(__x86_64__)||defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+using Append=const unsigned char*(*)(const unsigned char*,std::string&);
+
+//参数的二进制编码：size()是编码后的字节数，encode()写入，append()从编码中读出并格式化到out后面
+template<class T,class=void>
+struct Codec{
+    static_assert(std::is_trivially_copyable<T>::value,"AsyncLogger arguments must be strings or trivially copyable");
+    static size_t size(const T&){return sizeof(T);}
+    static unsigned char* encode(unsigned char* p,const T& v){
+        std::memcpy(p,&v,sizeof(T));
+        return p+sizeof(T);
+    }
+    static const unsigned char* append(const unsigned char* p,std::string& out){
+        alignas(T) unsigned char raw[sizeof(T)];
+        std::memcpy(raw,p,sizeof(T));
+        std::ostringstream os;
+        os<<*reinterpret_cast<const T*>(raw);
+        out+=os.str();
+        return p+sizeof(T);
+    }
+};
+
+template<class T>
+struct Codec<T,typename std::enable_if<std::is_arithmetic<T>::value>::type>{
+    static size_t size(const T&){return sizeof(T);}
+    static unsigned char* encode(unsigned char* p,const T& v){
+        std::memcpy(p,&v,sizeof(T));
+        return p+sizeof(T);
+    }
+    static const unsigned char* append(const unsigned char* p,std::string& out){
+        T v;
+        std::memcpy(&v,p,sizeof(T));
+        if constexpr(std::is_same<T,bool>::value){
+            out+=v?"true":"false";
+        }else if constexpr(std::is_same<T,char>::value){
+            out+=v;
+        }else if constexpr(std::is_integral<T>::value){
+            out+=std::to_string(v);
+        }else{
+            char text[32];//%g与ostream<<的默认格式相同
+            int n=std::snprintf(text,sizeof(text),"%g",static_cast<double>(v));
+            out.append(text,n>0?static_cast<size_t>(n):0);
+        }
+        return p+sizeof(T);
+    }
+};
+
+//字符串：4字节长度加内容
+struct StringCodec{
+    static size_t size(std::string_view s){return sizeof(uint32_t)+s.size();}
+    static unsigned char* encode(unsigned char* p,std::string_view s){
+        uint32_t n=static_cast<uint32_t>(s.size());
+        std::memcpy(p,&n,sizeof(n));
+        std::memcpy(p+sizeof(n),s.data(),n);
+        return p+sizeof(n)+n;
+    }
+    static const unsigned char* append(const unsigned char* p,std::string& out){
+        uint32_t n;
+        std::memcpy(&n,p,sizeof(n));
+        out.append(reinterpret_cast<const char*>(p+sizeof(n)),n);
+        return p+sizeof(n)+n;
+    }
+};
+
+template<>struct Codec<const char*>:StringCodec{};
+template<>struct Codec<char*>:StringCodec{};
+template<>struct Codec<std::string>:StringCodec{};
+template<>struct Codec<std::string_view>:StringCodec{};
+
+template<class T>
+using Stored=typename std::decay<T>::type;
+
+//把fmt中的{}依次替换为参数；多余的{}原样输出
+template<class... Args>
+void format(const char* fmt,const unsigned char* p,std::string& out){
+    static constexpr Append appenders[sizeof...(Args)+1]={&Codec<Args>::append...,nullptr};
+    size_t next=0;
+    for(const char* c=fmt;*c;++c){
+        if(c[0]=='{'&&c[1]=='}'&&next<sizeof...(Args)){
+            p=appenders[next++](p,out);
+            ++c;
+        }else{
+            out+=*c;
+        }
+    }
+}
+
+}
+
+class AsyncLogger{
+    private:
+        static constexpr size_t cache_line=64;
+
+        struct Header{
+            uint32_t size;//整条记录的字节数（8字节对齐）；format为nullptr时是绕回前的填充
+            uint32_t reserved;
+            uint64_t stamp;
+            void(*format)(const char*,const unsigned char*,std::string&);
+            const char* fmt;
+        };
+
+        //单生产者（所属线程）单消费者（后台线程）的环形字节缓冲区，head和tail只增不减
+        struct Buffer{
+            alignas(cache_line) std::atomic<uint64_t>tail{0};
+            uint64_t cached_head=0;
+            alignas(cache_line) std::atomic<uint64_t>head{0};
+            std::atomic<bool>retired{false};//所属线程已经退出
+            const size_t mask;
+            std::unique_ptr<unsigned char[]>data;
+
+            explicit Buffer(size_t capacity):mask(capacity-1),data(new unsigned char[capacity]){}
+            size_t capacity()const{return mask+1;}
+        };
+
+        //每个线程对每个logger持有一个缓冲区；线程退出时标记retired，后台取完剩余记录后丢弃
+        struct ThreadBuffers{
+            std::vector<std::pair<uint64_t,std::shared_ptr<Buffer>>>entries;
+            ~ThreadBuffers(){
+                for(auto& e:entries)
+                    e.second->retired.store(true,std::memory_order_release);
+            }
+        };
+
+        struct Pending{
+            uint64_t stamp;
+            const Header* header;
+        };
+
+        const uint64_t id;
+        const size_t buffer_size;
+        std::ostream& out;
+        const std::chrono::microseconds interval;
+
+        std::mutex registry_mutex;
+        std::vector<std::shared_ptr<Buffer>>buffers;
+
+        std::mutex mutex;
+        std::condition_variable wakeup;
+        std::condition_variable flushed;
+        bool stop=false;
+        bool wake_requested=false;
+        uint64_t flush_requested=0;
+        uint64_t flush_done=0;
+        std::atomic<uint64_t>dropped_count{0};
+        std::thread worker;
+
+        static uint64_t next_id(){
+            static std::atomic<uint64_t>next{0};
+            return next.fetch_add(1,std::memory_order_relaxed)+1;
+        }
+
+        static size_t round_up(size_t n){
+            size_t c=1;
+            while(c<n)
+                c<<=1;
+            return c;
+        }
+
+        static size_t align8(size_t n){return (n+7)&~size_t(7);}
+
+        Buffer& local_buffer(){
+            static thread_local ThreadBuffers local;
+            static thread_local uint64_t cached_id=0;
+            static thread_local Buffer* cached=nullptr;
+            if(cached_id==id)
+                return *cached;
+            for(auto& e:local.entries){
+                if(e.first==id){
+                    cached_id=id;
+                    cached=e.second.get();
+                    return *cached;
+                }
+            }
+            auto buffer=std::make_shared<Buffer>(buffer_size);
+            {
+                std::lock_guard<std::mutex>lock(registry_mutex);
+                buffers.push_back(buffer);
+            }
+            local.entries.emplace_back(id,buffer);
+            cached_id=id;
+            cached=buffer.get();
+            return *cached;
+        }
+
+        void request_wakeup(){
+            std::lock_guard<std::mutex>lock(mutex);
+            wake_requested=true;
+            wakeup.notify_one();
+        }
+
+        //在buffer中预留need字节的连续空间，必要时先写一条填充记录绕回到开头；返回写入位置
+        unsigned char* reserve(Buffer& b,size_t need,uint64_t& tail){
+            tail=b.tail.load(std::memory_order_relaxed);
+            size_t pos=tail&b.mask;
+            size_t to_end=b.capacity()-pos;
+            size_t skip=to_end<need?to_end:0;
+            while(tail+skip+need-b.cached_head>b.capacity()){
+                b.cached_head=b.head.load(std::memory_order_acquire);
+                if(tail+skip+need-b.cached_head<=b.capacity())
+                    break;
+                request_wakeup();
+                std::this_thread::yield();
+            }
+            if(skip){
+                if(skip>=sizeof(Header)){//放不下Header的尾部空间由双方约定直接跳过
+                    Header pad{static_cast<uint32_t>(skip),0,0,nullptr,nullptr};
+                    std::memcpy(b.data.get()+pos,&pad,sizeof(pad));
+                }
+                tail+=skip;
+                pos=0;
+            }
+            return b.data.get()+pos;
+        }
+
+        void run();
+
+    public:
+        //buffer_size是每个线程的缓冲区字节数（向上取整到2的幂）
+        explicit AsyncLogger(std::ostream& sink=std::cout,size_t buffer_size=256*1024,
+                             std::chrono::microseconds flush_interval=std::chrono::milliseconds(2))
+            :id(next_id()),buffer_size(round_up(std::max<size_t>(buffer_size,4096))),out(sink),interval(flush_interval){
+            worker=std::thread([this]{run();});
+        }
+
+        AsyncLogger(const AsyncLogger&)=delete;
+        AsyncLogger& operator=(const AsyncLogger&)=delete;
+
+        ~AsyncLogger(){
+            {
+                std::lock_guard<std::mutex>lock(mutex);
+                stop=true;
+            }
+            wakeup.notify_one();
+            worker.join();
+        }
+
+        template<size_t N,class... Args>
+        void log(const char(&fmt)[N],const Args&... args){
+            size_t need=align8(sizeof(Header)+(size_t(0)+...+log_detail::Codec<log_detail::Stored<Args>>::size(args)));
+            Buffer& b=local_buffer();
+            if(need>b.capacity()/4){
+                dropped_count.fetch_add(1,std::memory_order_relaxed);
+                return;
+            }
+            uint64_t tail;
+            unsigned char* p=reserve(b,need,tail);
+            if constexpr(sizeof...(Args)>0){
+                unsigned char* payload=p+sizeof(Header);
+                ((payload=log_detail::Codec<log_detail::Stored<Args>>::encode(payload,args)),...);
+            }
+            Header h{static_cast<uint32_t>(need),0,log_detail::stamp(),
+                     &log_detail::format<log_detail::Stored<Args>...>,fmt};
+            std::memcpy(p,&h,sizeof(h));
+            b.tail.store(tail+need,std::memory_order_release);
+        }
+
+        //等待调用之前记录的所有日志写到输出流
+        void flush(){
+            std::unique_lock<std::mutex>lock(mutex);
+            uint64_t ticket=++flush_requested;
+            wakeup.notify_one();
+            flushed.wait(lock,[&]{return flush_done>=ticket;});
+        }
+
+        uint64_t dropped()const{return dropped_count.load(std::memory_order_relaxed);}
+};
+
+inline void AsyncLogger::run(){
+    std::vector<std::shared_ptr<Buffer>>snapshot;
+    std::vector<uint64_t>new_heads;
+    std::vector<Pending>batch;
+    std::string text;
+    uint64_t previous=log_detail::stamp();
+    for(;;){
+        uint64_t flush_ticket;
+        bool stopping;
+        {
+            std::unique_lock<std::mutex>lock(mutex);
+            wakeup.wait_for(lock,interval,[this]{return stop||wake_requested||flush_requested>flush_done;});
+            wake_requested=false;
+            flush_ticket=flush_requested;
+            stopping=stop;
+        }
+        bool all=stopping||flush_ticket>flush_done;
+        uint64_t now=log_detail::stamp();
+        uint64_t cutoff=all?UINT64_MAX:previous;//只输出上一轮之前的记录，给正在发布的线程留出余量
+        previous=now;
+
+        {
+            std::lock_guard<std::mutex>lock(registry_mutex);
+            snapshot.assign(buffers.begin(),buffers.end());
+        }
+        batch.clear();
+        new_heads.assign(snapshot.size(),0);
+        for(size_t i=0;i<snapshot.size();++i){
+            Buffer& b=*snapshot[i];
+            uint64_t head=b.head.load(std::memory_order_relaxed);
+            uint64_t tail=b.tail.load(std::memory_order_acquire);
+            while(head<tail){
+                size_t pos=head&b.mask;
+                size_t to_end=b.capacity()-pos;
+                if(to_end<sizeof(Header)){
+                    head+=to_end;
+                    continue;
+                }
+                const Header* h=reinterpret_cast<const Header*>(b.data.get()+pos);
+                if(h->format&&h->stamp>cutoff)
+                    break;
+                if(h->format)
+                    batch.push_back(Pending{h->stamp,h});
+                head+=h->size;
+            }
+            new_heads[i]=head;
+        }
+        std::stable_sort(batch.begin(),batch.end(),[](const Pending& a,const Pending& b){return a.stamp<b.stamp;});
+        text.clear();
+        for(const Pending& p:batch){
+            p.header->format(p.header->fmt,reinterpret_cast<const unsigned char*>(p.header+1),text);
+            text+='\n';
+        }
+        if(!text.empty()){
+            out.write(text.data(),static_cast<std::streamsize>(text.size()));
+            out.flush();
+        }
+        for(size_t i=0;i<snapshot.size();++i)//格式化完成之后才归还空间
+            snapshot[i]->head.store(new_heads[i],std::memory_order_release);
+        {
+            std::lock_guard<std::mutex>lock(registry_mutex);
+            buffers.erase(std::remove_if(buffers.begin(),buffers.end(),[](const std::shared_ptr<Buffer>& b){
+                return b->retired.load(std::memory_order_acquire)&&
+                       b->head.load(std::memory_order_relaxed)==b->tail.load(std::memory_order_acquire);
+            }),buffers.end());
+        }
+        snapshot.clear();
+        if(all){
+            std::lock_guard<std::mutex>lock(mutex);
+            flush_done=flush_ticket;
+            flushed.notify_all();
+        }
+        if(stopping)
+            return;
+    }
+}
+
+//进程内共用的日志，输出到std::cout
+inline AsyncLogger& async_log(){
+    static AsyncLogger logger;
+    return logger;
+}
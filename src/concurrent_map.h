@@ -0,0 +1,221 @@
+#pragma once
+#include<cstddef>
+#include<cstdint>
+#include<functional>
+#include<memory>
+#include<mutex>
+#include<optional>
+#include<shared_mutex>
+#include<string>
+#include<string_view>
+#include<thread>
+#include<utility>
+#include<vector>
+
+/*
+    分段锁并发哈希表
+
+    一个shared_mutex保护整个unordered_map时，任何一次写都会挡住所有key的读。
+    ConcurrentHashMap把数据分成多个分段（shard），用key的哈希值选择分段：
+    * 每个分段有自己的读写锁和自己的开放寻址表（线性探测），按缓存行对齐，不同分段之间没有伪共享
+    * 不同分段上的读写互不影响；只有哈希到同一分段的写才会阻塞读
+    * 每个分段独立扩容，扩容时只持有该分段的写锁，其他分段照常读写
+    * 查找接口是模板：Hash和KeyEqual定义了is_transparent时（例如StringHash和std::equal_to<>），
+      可以直接用std::string_view、const char*查找，不需要先构造一个std::string
+    * Lock默认是std::shared_mutex，可以换成其他提供lock/unlock/lock_shared/unlock_shared的读写锁
+*/
+
+//支持异构查找的字符串哈希：std::string、std::string_view、const char*得到相同的哈希值
+struct StringHash{
+    using is_transparent=void;
+    size_t operator()(std::string_view s)const{return std::hash<std::string_view>{}(s);}
+};
+
+template<typename K,typename V,typename Hash=std::hash<K>,typename KeyEqual=std::equal_to<K>,typename Lock=std::shared_mutex>
+class ConcurrentHashMap{
+    private:
+        static constexpr size_t cache_line=64;
+        static constexpr size_t initial_capacity=8;
+
+        enum class State:uint8_t{Empty,Full,Deleted};
+
+        struct Slot{
+            State state=State::Empty;
+            size_t hash=0;
+            std::optional<std::pair<K,V>>kv;
+        };
+
+        struct alignas(cache_line) Shard{
+            mutable Lock lock;
+            std::vector<Slot>slots;//容量为2的幂
+            size_t size=0;
+            size_t deleted=0;
+        };
+
+        const size_t shard_mask;
+        std::unique_ptr<Shard[]>shards;
+        Hash hasher;
+        KeyEqual equal;
+
+        //把哈希值打散：高位选择分段，低位选择分段内的槽位
+        static size_t mix(size_t h){
+            uint64_t x=h;
+            x^=x>>33;
+            x*=0xff51afd7ed558ccdULL;
+            x^=x>>33;
+            x*=0xc4ceb9fe1a85ec53ULL;
+            x^=x>>33;
+            return static_cast<size_t>(x);
+        }
+
+        static size_t round_up(size_t n){
+            size_t c=1;
+            while(c<n&&c<(size_t(1)<<16))
+                c<<=1;
+            return c;
+        }
+
+        template<typename Q>
+        size_t hash_of(const Q& key)const{return mix(hasher(key));}
+
+        Shard& shard_for(size_t h)const{
+            return shards[(h>>(sizeof(size_t)*8-16))&shard_mask];
+        }
+
+        //返回key所在槽位的下标，不存在时返回slots.size()；调用者需要持有分段的锁
+        template<typename Q>
+        size_t locate(const Shard& shard,const Q& key,size_t h)const{
+            if(shard.slots.empty())
+                return 0;
+            size_t mask=shard.slots.size()-1;
+            for(size_t i=h&mask;;i=(i+1)&mask){
+                const Slot& slot=shard.slots[i];
+                if(slot.state==State::Empty)
+                    return shard.slots.size();
+                if(slot.state==State::Full&&slot.hash==h&&equal(slot.kv->first,key))
+                    return i;
+            }
+        }
+
+        //在分段内重新分配容量并重新插入所有元素，同时清除墓碑；调用者需要持有分段的写锁
+        static void rehash(Shard& shard,size_t capacity){
+            std::vector<Slot>old;
+            old.swap(shard.slots);
+            shard.slots.resize(capacity);
+            size_t mask=capacity-1;
+            for(Slot& slot:old){
+                if(slot.state!=State::Full)
+                    continue;
+                size_t i=slot.hash&mask;
+                while(shard.slots[i].state!=State::Empty)
+                    i=(i+1)&mask;
+                shard.slots[i]=std::move(slot);
+            }
+            shard.deleted=0;
+        }
+
+        //保证再插入一个元素后已用槽位（包括墓碑）不超过3/4
+        static void reserve_one(Shard& shard){
+            size_t capacity=shard.slots.size();
+            if(capacity==0){
+                shard.slots.resize(initial_capacity);
+                return;
+            }
+            if((shard.size+shard.deleted+1)*4<=capacity*3)
+                return;
+            //墓碑较多时原地清理，否则容量翻倍
+            rehash(shard,(shard.size+1)*2<=capacity?capacity:capacity*2);
+        }
+
+    public:
+        //分段数向上取整到2的幂，最多65536个
+        explicit ConcurrentHashMap(size_t shard_count=std::thread::hardware_concurrency()*4)
+            :shard_mask(round_up(shard_count)-1),shards(new Shard[shard_mask+1]){}
+        ConcurrentHashMap(const ConcurrentHashMap&)=delete;
+        ConcurrentHashMap& operator=(const ConcurrentHashMap&)=delete;
+
+        //找到时把值复制到out并返回true
+        template<typename Q>
+        bool find(const Q& key,V& out)const{
+            size_t h=hash_of(key);
+            const Shard& shard=shard_for(h);
+            std::shared_lock<Lock>lock(shard.lock);
+            size_t i=locate(shard,key,h);
+            if(i>=shard.slots.size())
+                return false;
+            out=shard.slots[i].kv->second;
+            return true;
+        }
+
+        //找到时在读锁内调用f(const V&)，不需要复制值；f中不能再访问同一个表
+        template<typename Q,typename F>
+        bool visit(const Q& key,F&& f)const{
+            size_t h=hash_of(key);
+            const Shard& shard=shard_for(h);
+            std::shared_lock<Lock>lock(shard.lock);
+            size_t i=locate(shard,key,h);
+            if(i>=shard.slots.size())
+                return false;
+            f(static_cast<const V&>(shard.slots[i].kv->second));
+            return true;
+        }
+
+        template<typename Q>
+        bool contains(const Q& key)const{
+            return visit(key,[](const V&){});
+        }
+
+        //插入新元素返回true，key已存在时覆盖原来的值并返回false
+        template<typename KK,typename VV>
+        bool insert_or_assign(KK&& key,VV&& value){
+            size_t h=hash_of(key);
+            Shard& shard=shard_for(h);
+            std::unique_lock<Lock>lock(shard.lock);
+            size_t i=locate(shard,key,h);
+            if(i<shard.slots.size()){
+                shard.slots[i].kv->second=std::forward<VV>(value);
+                return false;
+            }
+            reserve_one(shard);
+            size_t mask=shard.slots.size()-1;
+            i=h&mask;
+            while(shard.slots[i].state==State::Full)//墓碑可以直接重用
+                i=(i+1)&mask;
+            Slot& slot=shard.slots[i];
+            if(slot.state==State::Deleted)
+                --shard.deleted;
+            slot.kv.emplace(std::forward<KK>(key),std::forward<VV>(value));
+            slot.hash=h;
+            slot.state=State::Full;
+            ++shard.size;
+            return true;
+        }
+
+        template<typename Q>
+        bool erase(const Q& key){
+            size_t h=hash_of(key);
+            Shard& shard=shard_for(h);
+            std::unique_lock<Lock>lock(shard.lock);
+            size_t i=locate(shard,key,h);
+            if(i>=shard.slots.size())
+                return false;
+            Slot& slot=shard.slots[i];
+            slot.kv.reset();
+            slot.state=State::Deleted;//留下墓碑，保证后面的探测链不断开
+            --shard.size;
+            ++shard.deleted;
+            return true;
+        }
+
+        //依次锁住每个分段求和，并发修改时只是一个近似值
+        size_t size()const{
+            size_t n=0;
+            for(size_t s=0;s<=shard_mask;++s){
+                std::shared_lock<Lock>lock(shards[s].lock);
+                n+=shards[s].size;
+            }
+            return n;
+        }
+
+        size_t shard_count()const{return shard_mask+1;}
+};
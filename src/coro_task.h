@@ -0,0 +1,205 @@
+#pragma once
+/*
+    基于ThreadPool的C++20协程
+
+    std::async每次调用都可能创建一个线程，sleep_for会让整个线程什么都不做。协程挂起时不占用线程，
+    成千上万个并发的异步流程可以复用线程池中固定数量的工作线程：
+    * co_await pool.schedule()：切换到线程池的工作线程上继续执行（见thread_pool.h）
+    * task<T>：惰性启动的协程类型，被co_await时才开始执行；执行完后通过对称转移（symmetric transfer）
+      直接在同一个工作线程上恢复等待它的协程，不再经过队列
+    * co_await async_sleep(pool,d)：挂起协程，由线程池的定时线程（post_at）在到期后把协程的恢复提交到任务队列，
+      代替std::this_thread::sleep_for；线程池析构时还没有到期的协程不会再被恢复
+    * spawn(t)：分离地启动一个task<void>，不等待结果
+    * sync_wait(t)：在非协程代码中阻塞等待一个task完成并取得结果，用在main等最外层
+    需要C++20（-std=c++20）
+*/
+#if !defined(__cpp_impl_coroutine)
+#error "coro_task.h requires C++20 coroutines"
+#endif
+
+#include<chrono>
+#include<condition_variable>
+#include<coroutine>
+#include<exception>
+#include<mutex>
+#include<optional>
+#include<type_traits>
+#include<utility>
+#include<vector>
+#include"thread_pool.h"
+
+template<class T=void>
+class task;
+
+namespace detail{
+
+//协程结束时恢复等待它的协程；没有等待者时返回noop，控制权回到resume的调用者
+struct FinalAwaiter{
+    bool await_ready()const noexcept{return false;}
+    template<class Promise>
+    std::coroutine_handle<>await_suspend(std::coroutine_handle<Promise>h)noexcept{
+        std::coroutine_handle<>next=h.promise().continuation;
+        return next?next:std::noop_coroutine();
+    }
+    void await_resume()const noexcept{}
+};
+
+struct PromiseBase{
+    std::coroutine_handle<>continuation;
+    std::exception_ptr error;
+
+    std::suspend_always initial_suspend()noexcept{return {};}
+    FinalAwaiter final_suspend()noexcept{return {};}
+    void unhandled_exception()noexcept{error=std::current_exception();}
+};
+
+template<class T>
+struct TaskPromise:PromiseBase{
+    std::optional<T>value;
+    task<T>get_return_object()noexcept;
+    template<class U>
+    void return_value(U&& v){value.emplace(std::forward<U>(v));}
+    T result(){
+        if(error)
+            std::rethrow_exception(error);
+        return std::move(*value);
+    }
+};
+
+template<>
+struct TaskPromise<void>:PromiseBase{
+    task<void>get_return_object()noexcept;
+    void return_void()noexcept{}
+    void result(){
+        if(error)
+            std::rethrow_exception(error);
+    }
+};
+
+}
+
+template<class T>
+class task{
+    public:
+        using promise_type=detail::TaskPromise<T>;
+
+        task(task&& other)noexcept:handle(std::exchange(other.handle,nullptr)){}
+        task& operator=(task&& other)noexcept{
+            if(this!=&other){
+                if(handle)
+                    handle.destroy();
+                handle=std::exchange(other.handle,nullptr);
+            }
+            return *this;
+        }
+        task(const task&)=delete;
+        task& operator=(const task&)=delete;
+        ~task(){
+            if(handle)
+                handle.destroy();
+        }
+
+        //co_await一个task：记录等待者，然后直接转移到task的协程开始执行
+        auto operator co_await()&&noexcept{
+            struct Awaiter{
+                std::coroutine_handle<promise_type>handle;
+                bool await_ready()const noexcept{return false;}
+                std::coroutine_handle<>await_suspend(std::coroutine_handle<>awaiting)noexcept{
+                    handle.promise().continuation=awaiting;
+                    return handle;
+                }
+                T await_resume(){return handle.promise().result();}
+            };
+            return Awaiter{handle};
+        }
+
+    private:
+        friend promise_type;
+        explicit task(std::coroutine_handle<promise_type>h)noexcept:handle(h){}
+        std::coroutine_handle<promise_type>handle;
+};
+
+template<class T>
+task<T>detail::TaskPromise<T>::get_return_object()noexcept{
+    return task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline task<void>detail::TaskPromise<void>::get_return_object()noexcept{
+    return task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+namespace detail{
+
+//立即开始执行、结束后自动销毁协程帧的协程，用于spawn和sync_wait
+struct Detached{
+    struct promise_type{
+        Detached get_return_object()noexcept{return {};}
+        std::suspend_never initial_suspend()noexcept{return {};}
+        std::suspend_never final_suspend()noexcept{return {};}
+        void return_void()noexcept{}
+        void unhandled_exception()noexcept{std::terminate();}
+    };
+};
+
+template<class T>
+struct SyncWaitState{
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool done=false;
+    std::optional<std::conditional_t<std::is_void<T>::value,char,T>>value;
+    std::exception_ptr error;
+};
+
+template<class T>
+Detached run_sync_wait(task<T>t,SyncWaitState<T>& state){
+    try{
+        if constexpr(std::is_void<T>::value)
+            co_await std::move(t);
+        else
+            state.value.emplace(co_await std::move(t));
+    }catch(...){
+        state.error=std::current_exception();
+    }
+    std::lock_guard<std::mutex>lock(state.mutex);
+    state.done=true;
+    state.cv.notify_one();
+}
+
+inline Detached run_detached(task<void>t){
+    co_await std::move(t);//task中未捕获的异常会在这里重新抛出，导致std::terminate
+}
+
+}
+
+//挂起当前协程至少d时间，之后在pool的工作线程上恢复
+template<class Rep,class Period>
+auto async_sleep(ThreadPool& pool,std::chrono::duration<Rep,Period>d){
+    struct Awaiter{
+        ThreadPool& pool;
+        std::chrono::steady_clock::time_point deadline;
+        bool await_ready()const noexcept{return deadline<=std::chrono::steady_clock::now();}
+        void await_suspend(std::coroutine_handle<>h){
+            pool.post_at(deadline,[h]{h.resume();});
+        }
+        void await_resume()const noexcept{}
+    };
+    return Awaiter{pool,std::chrono::steady_clock::now()+std::chrono::duration_cast<std::chrono::steady_clock::duration>(d)};
+}
+
+//分离地启动一个task，不等待它完成；task内部通常先co_await pool.schedule()切换到线程池
+inline void spawn(task<void>t){
+    detail::run_detached(std::move(t));
+}
+
+//阻塞当前（非协程）线程直到task完成，返回它的结果或重新抛出它的异常
+template<class T>
+T sync_wait(task<T>t){
+    detail::SyncWaitState<T>state;
+    detail::run_sync_wait(std::move(t),state);
+    std::unique_lock<std::mutex>lock(state.mutex);
+    state.cv.wait(lock,[&]{return state.done;});
+    if(state.error)
+        std::rethrow_exception(state.error);
+    if constexpr(!std::is_void<T>::value)
+        return std::move(*state.value);
+}
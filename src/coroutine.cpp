@@ -0,0 +1,55 @@
+#include<iostream>
+#include<atomic>
+#include<chrono>
+#include<future>
+#include<memory>
+#include"coro_task.h"
+
+using namespace std::chrono_literals;
+
+//longRunningFunction的协程版本：等待期间协程挂起，不占用任何线程
+task<int> longRunningFunction(ThreadPool& pool,int input){
+    co_await async_sleep(pool,500ms);
+    co_return input*input;
+}
+
+task<int> pipeline(ThreadPool& pool){
+    co_await pool.schedule();//从这里开始在线程池的工作线程上执行
+    task<int> result=longRunningFunction(pool,4);//task是惰性的，co_await时才开始执行
+    std::cout<<"running other tasks..."<<std::endl;
+    int value=co_await std::move(result);
+    co_return value;
+}
+
+//所有操作共享的完成状态；set_value唤醒main之后工作线程可能还在set_value内部，所以由shared_ptr管理而不是main的局部变量
+struct Completion{
+    std::atomic<int> remaining;
+    std::promise<void> done;
+    explicit Completion(int count):remaining(count){}
+};
+
+//一个模拟的异步操作：切换到线程池，等待一段时间，然后计数
+task<void> operation(ThreadPool& pool,std::shared_ptr<Completion> completion){
+    co_await pool.schedule();
+    co_await async_sleep(pool,100ms);
+    if(completion->remaining.fetch_sub(1)==1)
+        completion->done.set_value();
+}
+
+int main(){
+    ThreadPool pool(4);
+    int result=sync_wait(pipeline(pool));
+    std::cout<<"the result of longRunningFunction is:"<<result<<std::endl;
+
+    //10000个并发操作复用4个工作线程，每个都等待100ms，总耗时仍然接近100ms
+    const int count=10000;
+    auto completion=std::make_shared<Completion>(count);
+    std::future<void> done=completion->done.get_future();
+    auto start=std::chrono::steady_clock::now();
+    for(int i=0;i<count;++i)
+        spawn(operation(pool,completion));
+    done.wait();
+    auto elapsed=std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-start);
+    std::cout<<count<<" concurrent operations on "<<pool.size()<<" workers took "<<elapsed.count()<<"ms"<<std::endl;
+    return 0;
+}
@@ -0,0 +1,210 @@
+#pragma once
+#include<algorithm>
+#include<cstddef>
+#include<fstream>
+#include<sstream>
+#include<string>
+#include<thread>
+#include<vector>
+#if defined(__linux__)
+#include<pthread.h>
+#include<sched.h>
+#endif
+
+/*
+    CPU拓扑和线程绑定
+
+    CpuTopology::detect()从Linux的sysfs读取每个逻辑CPU所属的物理核、三级缓存（LLC）、NUMA节点和插槽：
+        /sys/devices/system/cpu/cpuN/topology/core_id、physical_package_id
+        /sys/devices/system/cpu/cpuN/cache/indexK/level、shared_cpu_list
+        /sys/devices/system/node/nodeK/cpulist
+    只保留当前进程允许运行的CPU（sched_getaffinity，容器和taskset的限制）；
+    读不到的信息按"所有CPU在同一个缓存/节点上，每个CPU一个物理核"处理，非Linux平台上绑定不生效
+
+    distance(a,b)表示两个CPU之间共享的程度：0同一个物理核（超线程），1共享LLC，2同一个NUMA节点，3跨节点
+    ThreadPool用它决定每个工作线程窃取其他线程的顺序：先偷共享缓存的邻居，最后才跨NUMA节点
+*/
+
+struct CpuInfo{
+    int cpu;
+    int core;//(package,core_id)编号后的全局物理核号
+    int llc;//共享最后一级缓存的CPU中编号最小的一个
+    int node;
+    int package;
+};
+
+class CpuTopology{
+    private:
+        std::vector<CpuInfo>infos;
+
+        static bool read_int(const std::string& path,int& value){
+            std::ifstream in(path);
+            return static_cast<bool>(in>>value);
+        }
+
+        //解析"0-3,8,10-11"格式的CPU列表
+        static std::vector<int>parse_list(const std::string& text){
+            std::vector<int>cpus;
+            std::stringstream ss(text);
+            std::string part;
+            while(std::getline(ss,part,',')){
+                if(part.empty()||part[0]=='\n')
+                    continue;
+                size_t dash=part.find('-');
+                try{
+                    int first=std::stoi(part.substr(0,dash));
+                    int last=dash==std::string::npos?first:std::stoi(part.substr(dash+1));
+                    for(int c=first;c<=last;++c)
+                        cpus.push_back(c);
+                }catch(...){
+                    return {};
+                }
+            }
+            return cpus;
+        }
+
+        static std::vector<int>read_list(const std::string& path){
+            std::ifstream in(path);
+            std::string text;
+            if(!std::getline(in,text))
+                return {};
+            return parse_list(text);
+        }
+
+        static std::vector<int>allowed_cpus(){
+            std::vector<int>cpus;
+#if defined(__linux__)
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if(sched_getaffinity(0,sizeof(set),&set)==0){
+                for(int c=0;c<CPU_SETSIZE;++c){
+                    if(CPU_ISSET(c,&set))
+                        cpus.push_back(c);
+                }
+            }
+#endif
+            if(cpus.empty()){
+                unsigned n=std::thread::hardware_concurrency();
+                for(unsigned c=0;c<(n?n:1);++c)
+                    cpus.push_back(static_cast<int>(c));
+            }
+            return cpus;
+        }
+
+        const CpuInfo* find(int cpu)const{
+            for(const CpuInfo& info:infos){
+                if(info.cpu==cpu)
+                    return &info;
+            }
+            return nullptr;
+        }
+
+    public:
+        static CpuTopology detect(){
+            CpuTopology t;
+            const std::string base="/sys/devices/system/cpu/cpu";
+            std::vector<std::pair<int,int>>cores;//(package,core_id)，下标即全局物理核号
+            for(int cpu:allowed_cpus()){
+                std::string dir=base+std::to_string(cpu);
+                CpuInfo info{cpu,-1-cpu,0,0,0};//读不到core_id时每个CPU单独算一个物理核
+                int core_id;
+                read_int(dir+"/topology/physical_package_id",info.package);
+                if(read_int(dir+"/topology/core_id",core_id)){
+                    std::pair<int,int>key(info.package,core_id);
+                    auto it=std::find(cores.begin(),cores.end(),key);
+                    info.core=static_cast<int>(it-cores.begin());
+                    if(it==cores.end())
+                        cores.push_back(key);
+                }
+                //最高一级的缓存就是LLC，用共享它的最小CPU号作为编号
+                int best_level=0;
+                for(int index=0;;++index){
+                    std::string cache=dir+"/cache/index"+std::to_string(index);
+                    int level;
+                    if(!read_int(cache+"/level",level))
+                        break;
+                    std::vector<int>shared=read_list(cache+"/shared_cpu_list");
+                    if(level>best_level&&!shared.empty()){
+                        best_level=level;
+                        info.llc=*std::min_element(shared.begin(),shared.end());
+                    }
+                }
+                t.infos.push_back(info);
+            }
+            for(int node=0;;++node){
+                std::ifstream probe("/sys/devices/system/node/node"+std::to_string(node)+"/cpulist");
+                if(!probe)
+                    break;
+                for(int cpu:read_list("/sys/devices/system/node/node"+std::to_string(node)+"/cpulist")){
+                    for(CpuInfo& info:t.infos){
+                        if(info.cpu==cpu)
+                            info.node=node;
+                    }
+                }
+            }
+            return t;
+        }
+
+        const std::vector<CpuInfo>& cpus()const{return infos;}
+
+        //每个物理核取编号最小的一个逻辑CPU（不把两个工作线程放到同一个核的两个超线程上）
+        std::vector<int>one_per_core()const{
+            std::vector<int>result;
+            std::vector<int>seen;
+            for(const CpuInfo& info:infos){
+                if(std::find(seen.begin(),seen.end(),info.core)!=seen.end())
+                    continue;
+                seen.push_back(info.core);
+                result.push_back(info.cpu);
+            }
+            return result;
+        }
+
+        //0同一个物理核，1共享LLC，2同一个NUMA节点，3更远；不认识的CPU算作最远
+        int distance(int a,int b)const{
+            const CpuInfo* x=find(a);
+            const CpuInfo* y=find(b);
+            if(!x||!y)
+                return 3;
+            if(x->core==y->core)
+                return 0;
+            if(x->llc==y->llc&&x->package==y->package)
+                return 1;
+            if(x->node==y->node)
+                return 2;
+            return 3;
+        }
+};
+
+/*
+    工作线程的绑定方式，作为ThreadPool构造函数的参数
+    * none()：不绑定，由操作系统调度（默认）
+    * cpus(list)：第i个工作线程绑定到list[i%list.size()]
+    * physical_cores()：每个物理核一个工作线程（超过物理核数时从头开始复用）
+*/
+struct Affinity{
+    std::vector<int>cpu_list;
+
+    static Affinity none(){return Affinity{};}
+    static Affinity cpus(std::vector<int>list){return Affinity{std::move(list)};}
+    static Affinity physical_cores(){return Affinity{CpuTopology::detect().one_per_core()};}
+
+    bool enabled()const{return !cpu_list.empty();}
+    int cpu_for(size_t worker)const{return enabled()?cpu_list[worker%cpu_list.size()]:-1;}
+};
+
+//把线程t绑定到cpu上，成功返回true
+inline bool pin_thread(std::thread& t,int cpu){
+#if defined(__linux__)
+    if(cpu<0||cpu>=CPU_SETSIZE)
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu,&set);
+    return pthread_setaffinity_np(t.native_handle(),sizeof(set),&set)==0;
+#else
+    (void)t;
+    (void)cpu;
+    return false;
+#endif
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include<atomic>
+#include<cstddef>
+#include<cstdint>
+#include<memory>
+#include<mutex>
+#include<thread>
+#include"wait_policy.h"
+
+/*
+    读偏向的分布式读写锁（per-thread reader indicators）
+
+    std::shared_mutex / boost::shared_mutex的每次lock_shared都要对同一个读者计数做一次原子RMW，
+    读多写少时这条缓存行在所有读线程的核之间来回传递，读线程越多吞吐量反而越低。
+    DistributedSharedMutex把读者计数分散到多个按缓存行对齐的槽位：
+    * 每个线程第一次使用时分到一个固定的槽位（和ShardedCounter相同），lock_shared只在自己的槽位上加一，
+      再读一次writer标志；没有写者时读者之间不共享任何被写的缓存行
+    * 默认最多8个槽位，线程更多时按线程编号共用槽位；单独使用一把锁且读线程很多时可以在构造时指定更多槽位
+    * 写者先用writer_mutex和其他写者互斥，再设置writer标志（收回读偏向），新的读者看到标志后退回并等待，
+      写者等所有槽位上已经进入的读者退出（计数归零）之后才进入临界区
+    * 读者加一、读者读writer标志、写者设置标志、写者扫描槽位都是seq_cst，四个操作处于同一个全序中：
+      要么读者看到writer标志，要么写者扫描时看到读者的计数，两者不会同时进入（x86上seq_cst的load就是普通的mov）
+    * 写者的代价和槽位数成正比，适合读远多于写的场景；写者等待期间新的读者被挡住，写者不会饿死
+    * 等待按WaitPolicy进行：先自旋，再让出，最后在ParkingSpot上睡眠
+
+    满足SharedMutex的要求（lock/try_lock/unlock/lock_shared/try_lock_shared/unlock_shared），
+    可以直接用于std::shared_lock、std::unique_lock，或作为ConcurrentHashMap的Lock参数。
+    同一次共享加锁的lock_shared和unlock_shared必须在同一个线程中调用（槽位按线程选择）
+*/
+
+class DistributedSharedMutex{
+    private:
+        static constexpr size_t cache_line=64;
+
+        struct alignas(cache_line) Slot{
+            std::atomic<uint32_t>readers{0};
+        };
+
+        const size_t mask;
+        std::unique_ptr<Slot[]>slots;
+        alignas(cache_line) std::atomic<bool>writer{false};
+        std::mutex writer_mutex;
+        ParkingSpot writer_done;//读者等待写者结束
+        ParkingSpot readers_done;//写者等待读者退出
+        WaitPolicy policy;
+
+        static constexpr size_t max_default_slots=8;
+
+        //默认槽位数不超过8：锁常常成组使用（例如ConcurrentHashMap每个分段一把），
+        //槽位数跟着核数走时总内存是 分段数*核数 条缓存行，写者的扫描也随核数变长
+        static size_t default_slots(){
+            size_t n=std::thread::hardware_concurrency();
+            return n==0||n>max_default_slots?max_default_slots:n;
+        }
+
+        static size_t round_up(size_t n){
+            size_t c=1;
+            while(c<n)
+                c<<=1;
+            return c;
+        }
+
+        static size_t thread_index(){
+            static std::atomic<size_t>next{0};
+            static thread_local size_t index=0;//0表示还没有分配
+            if(index==0)
+                index=next.fetch_add(1,std::memory_order_relaxed)+1;
+            return index;
+        }
+
+        Slot& my_slot(){
+            return slots[thread_index()&mask];
+        }
+
+        //扫描也必须是seq_cst：acquire读和写者的seq_cst store之间没有全序保证，Dekker式的握手不成立
+        bool drained()const{
+            for(size_t i=0;i<=mask;++i){
+                if(slots[i].readers.load(std::memory_order_seq_cst)!=0)
+                    return false;
+            }
+            return true;
+        }
+
+        //在自己的槽位上登记；writer已经设置时撤销登记并返回false
+        bool enter(Slot& slot){
+            slot.readers.fetch_add(1,std::memory_order_seq_cst);
+            if(!writer.load(std::memory_order_seq_cst))
+                return true;
+            leave(slot);
+            return false;
+        }
+
+        void release_writer(){
+            writer.store(false,std::memory_order_release);
+            writer_mutex.unlock();
+            writer_done.notify_all();
+        }
+
+        void leave(Slot& slot){
+            slot.readers.fetch_sub(1,std::memory_order_seq_cst);
+            if(writer.load(std::memory_order_seq_cst))//只有写者在等时才需要唤醒
+                readers_done.notify_all();
+        }
+
+    public:
+        explicit DistributedSharedMutex(size_t slot_count=default_slots(),WaitPolicy wait=WaitPolicy::adaptive())
+            :mask(round_up(slot_count)-1),slots(new Slot[mask+1]),policy(wait){}
+        DistributedSharedMutex(const DistributedSharedMutex&)=delete;
+        DistributedSharedMutex& operator=(const DistributedSharedMutex&)=delete;
+
+        void lock_shared(){
+            Slot& slot=my_slot();
+            while(!enter(slot)){
+                wait_until(writer_done,policy,[this]{
+                    return !writer.load(std::memory_order_acquire);
+                });
+            }
+        }
+
+        bool try_lock_shared(){
+            return enter(my_slot());
+        }
+
+        void unlock_shared(){
+            leave(my_slot());
+        }
+
+        void lock(){
+            writer_mutex.lock();
+            writer.store(true,std::memory_order_seq_cst);
+            wait_until(readers_done,policy,[this]{return drained();});
+        }
+
+        bool try_lock(){
+            if(!writer_mutex.try_lock())
+                return false;
+            writer.store(true,std::memory_order_seq_cst);
+            if(drained())
+                return true;
+            release_writer();
+            return false;
+        }
+
+        void unlock(){
+            release_writer();
+        }
+
+        size_t slot_count()const{return mask+1;}
+};
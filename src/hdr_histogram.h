@@ -0,0 +1,132 @@
+#pragma once
+#include<atomic>
+#include<cstddef>
+#include<cstdint>
+#include<memory>
+
+/*
+    HDR风格的延迟直方图（对数-线性分桶）
+
+    * 小于128的值每个值一个桶；之后每个2的幂区间分成64个桶，相对误差不超过1/64（约1.6%）
+    * 覆盖整个uint64_t范围，一共3776个桶，记录一次只是计算下标再加一，不分配内存
+    * 单写者：record只能由一个线程调用（每个线程或每个工作线程各用一个直方图），
+      计数用relaxed原子变量的load+store实现，其他线程可以随时读取或merge，不需要加锁，也不会有数据竞争
+    * 多个线程的直方图用merge合并后再求百分位
+*/
+class HdrHistogram{
+    public:
+        static constexpr unsigned sub_bits=7;
+        static constexpr uint64_t sub_count=uint64_t(1)<<sub_bits;
+        static constexpr uint64_t half_count=sub_count/2;
+        static constexpr size_t bucket_count=sub_count+(64-sub_bits)*half_count;
+
+        HdrHistogram():counts(new std::atomic<uint64_t>[bucket_count]){
+            reset();
+        }
+        HdrHistogram(const HdrHistogram& other):HdrHistogram(){
+            merge(other);
+        }
+        HdrHistogram& operator=(const HdrHistogram& other){
+            if(this!=&other){
+                reset();
+                merge(other);
+            }
+            return *this;
+        }
+
+        static size_t index_of(uint64_t v){
+            if(v<sub_count)
+                return static_cast<size_t>(v);
+            unsigned msb=63-static_cast<unsigned>(__builtin_clzll(v));
+            unsigned shift=msb-(sub_bits-1);//v>>shift落在[half_count,sub_count)中
+            return static_cast<size_t>(sub_count+(shift-1)*half_count+((v>>shift)-half_count));
+        }
+
+        //桶中最大的值，用于报告百分位（保守地向上取）
+        static uint64_t highest_in(size_t index){
+            if(index<sub_count)
+                return index;
+            size_t k=index-sub_count;
+            unsigned shift=static_cast<unsigned>(k/half_count)+1;
+            uint64_t sub=half_count+k%half_count;
+            return ((sub+1)<<shift)-1;
+        }
+
+        //只能由拥有这个直方图的线程调用
+        void record(uint64_t v){
+            bump(counts[index_of(v)],1);
+            bump(total,1);
+            bump(sum,v);
+            if(v>max_.load(std::memory_order_relaxed))
+                max_.store(v,std::memory_order_relaxed);
+            if(v<min_.load(std::memory_order_relaxed))
+                min_.store(v,std::memory_order_relaxed);
+        }
+
+        //把other合并进来（other可以正在被它的写者记录），一般在汇总快照时调用
+        void merge(const HdrHistogram& other){
+            for(size_t i=0;i<bucket_count;++i){
+                uint64_t c=other.counts[i].load(std::memory_order_relaxed);
+                if(c)
+                    counts[i].fetch_add(c,std::memory_order_relaxed);
+            }
+            total.fetch_add(other.total.load(std::memory_order_relaxed),std::memory_order_relaxed);
+            sum.fetch_add(other.sum.load(std::memory_order_relaxed),std::memory_order_relaxed);
+            uint64_t m=other.max_.load(std::memory_order_relaxed);
+            if(m>max_.load(std::memory_order_relaxed))
+                max_.store(m,std::memory_order_relaxed);
+            m=other.min_.load(std::memory_order_relaxed);
+            if(m<min_.load(std::memory_order_relaxed))
+                min_.store(m,std::memory_order_relaxed);
+        }
+
+        void reset(){
+            for(size_t i=0;i<bucket_count;++i)
+                counts[i].store(0,std::memory_order_relaxed);
+            total.store(0,std::memory_order_relaxed);
+            sum.store(0,std::memory_order_relaxed);
+            max_.store(0,std::memory_order_relaxed);
+            min_.store(UINT64_MAX,std::memory_order_relaxed);
+        }
+
+        uint64_t count()const{return total.load(std::memory_order_relaxed);}
+        uint64_t max()const{return max_.load(std::memory_order_relaxed);}
+        uint64_t min()const{return count()?min_.load(std::memory_order_relaxed):0;}
+        double mean()const{
+            uint64_t n=count();
+            return n?static_cast<double>(sum.load(std::memory_order_relaxed))/n:0.0;
+        }
+
+        //p取值0~100，例如99.9；返回不小于该百分位上样本的值（在桶精度内）
+        uint64_t percentile(double p)const{
+            uint64_t n=count();
+            if(n==0)
+                return 0;
+            uint64_t rank=static_cast<uint64_t>(p/100.0*n+0.5);
+            if(rank<1)
+                rank=1;
+            if(rank>n)
+                rank=n;
+            uint64_t seen=0;
+            for(size_t i=0;i<bucket_count;++i){
+                seen+=counts[i].load(std::memory_order_relaxed);
+                if(seen>=rank){
+                    uint64_t v=highest_in(i);
+                    uint64_t m=max();
+                    return v<m?v:m;
+                }
+            }
+            return max();
+        }
+
+    private:
+        static void bump(std::atomic<uint64_t>& a,uint64_t v){
+            a.store(a.load(std::memory_order_relaxed)+v,std::memory_order_relaxed);
+        }
+
+        std::unique_ptr<std::atomic<uint64_t>[]>counts;
+        std::atomic<uint64_t>total;
+        std::atomic<uint64_t>sum;
+        std::atomic<uint64_t>max_;
+        std::atomic<uint64_t>min_;
+};
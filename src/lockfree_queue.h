@@ -0,0 +1,308 @@
+#pragma once
+#include<atomic>
+#include<memory>
+#include<mutex>
+#include<thread>
+#include<cstdint>
+#include<cstddef>
+#include<new>
+#include<utility>
+
+/*
+    Michael-Scott无锁队列 + 基于epoch的内存回收（EBR）+ 节点池
+
+    为什么不能在Dequeue里直接delete旧的头节点：
+        其他线程可能刚刚读到了同一个oldHead，正准备读oldHead->next，delete之后这次读就是use-after-free；
+        如果节点被释放后又被new出来放回队列，CAS还会遇到ABA问题
+    EBR的做法：
+        * 全局有一个epoch计数器，每个线程访问队列前先进入临界区，记录下自己看到的epoch
+        * 出队的节点不立即释放，而是按摘下节点之后读到的全局epoch放进本线程的"待回收"链表（limbo）
+        * 只有所有处于临界区的线程都已经看到当前epoch时，全局epoch才能加一
+        * 在epoch e退休的节点，等全局epoch到达e+2时，不可能再有任何线程持有它的指针，可以安全地重用
+    节点池：
+        * 可以重用的节点进入本线程的空闲链表，Enqueue优先从空闲链表取节点，稳定状态下不再调用new
+        * 生产者和消费者往往是不同的线程（节点在消费者那边被回收），
+          所以空闲链表过长时把一批节点交给共享池，空闲链表为空的线程从共享池取一批（每batch_size个节点才加一次锁）
+*/
+
+template<typename T>
+struct Node
+{
+    alignas(T) unsigned char storage[sizeof(T)];//节点中的数据直接存放在节点内部，不再单独make_shared
+    std::atomic<Node<T>*>next;//原子指针，用于存储链表中的下一个节点的地址
+    Node<T>* free_next;//在limbo链表、空闲链表中使用的普通指针，只有持有该链表的线程会访问
+
+    Node():next(nullptr),free_next(nullptr){}
+    T* value(){return std::launder(reinterpret_cast<T*>(storage));}
+};
+
+template<typename T>
+class LockFreeQueue
+{
+private:
+    static constexpr size_t batch_size=64;//空闲链表和共享池之间每次交换的节点数
+    static constexpr unsigned advance_interval=64;//每退休这么多个节点尝试推进一次全局epoch
+
+    //每个访问过队列的线程对应一条记录，按缓存行对齐，避免不同线程的记录之间伪共享
+    struct alignas(64) ThreadRecord{
+        std::atomic<uint64_t>state{0};//(epoch<<1)|active，active表示线程正在临界区内
+        std::atomic<std::thread::id>owner;
+        ThreadRecord* next=nullptr;//记录链表只增不删，发布之后next不再修改
+
+        //以下字段只有owner线程访问
+        uint64_t seen_epoch=0;
+        Node<T>* limbo[3]={nullptr,nullptr,nullptr};//按epoch%3分桶的待回收节点
+        uint64_t limbo_epoch[3]={0,0,0};
+        Node<T>* free=nullptr;
+        size_t free_count=0;
+        unsigned retired=0;
+    };
+
+    std::atomic<Node<T>*>head;
+    std::atomic<Node<T>*>tail;
+    std::atomic<uint64_t>global_epoch{2};
+    std::atomic<ThreadRecord*>records{nullptr};
+    const uint64_t id;//队列实例编号，用于thread_local缓存，防止队列析构后同一地址上的新队列误用旧记录
+
+    std::mutex pool_mutex;
+    Node<T>* pool=nullptr;
+
+    static uint64_t next_id(){
+        static std::atomic<uint64_t>counter{0};
+        return counter.fetch_add(1)+1;
+    }
+
+    ThreadRecord* local_record(){
+        struct Cache{uint64_t id=0;ThreadRecord* rec=nullptr;};
+        static thread_local Cache cache;
+        if(cache.id==id)
+            return cache.rec;
+        std::thread::id self=std::this_thread::get_id();
+        ThreadRecord* rec=records.load();
+        for(;rec;rec=rec->next){
+            //线程退出后它的id可能被新线程复用，此时新线程直接接管旧记录（旧线程不可能再处于临界区内）
+            if(rec->owner.load()==self)
+                break;
+        }
+        if(!rec){
+            rec=new ThreadRecord;
+            rec->owner.store(self);
+            rec->next=records.load();
+            while(!records.compare_exchange_weak(rec->next,rec)){}
+        }
+        cache.id=id;
+        cache.rec=rec;
+        return rec;
+    }
+
+    ThreadRecord* enter(){
+        ThreadRecord* rec=local_record();
+        uint64_t e=global_epoch.load();
+        while(true){
+            rec->state.store((e<<1)|1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);//发布active之后才能读队列中的指针
+            //读取e和发布之间全局epoch可能已经前进（推进者当时看到本线程不在临界区），此时按新的epoch重新登记
+            uint64_t now=global_epoch.load();
+            if(now==e)
+                break;
+            e=now;
+        }
+        if(rec->seen_epoch!=e){
+            rec->seen_epoch=e;
+            collect(rec,e);
+        }
+        return rec;
+    }
+
+    void leave(ThreadRecord* rec){
+        rec->state.store(rec->state.load(std::memory_order_relaxed)&~uint64_t(1),std::memory_order_release);
+    }
+
+    //所有处于临界区的线程都已经看到当前epoch时，把全局epoch加一
+    void try_advance(){
+        uint64_t e=global_epoch.load();
+        for(ThreadRecord* rec=records.load();rec;rec=rec->next){
+            uint64_t s=rec->state.load();
+            if((s&1)&&(s>>1)!=e)
+                return;
+        }
+        global_epoch.compare_exchange_strong(e,e+1);
+    }
+
+    void splice_free(ThreadRecord* rec,Node<T>*& list){
+        while(list){
+            Node<T>* n=list;
+            list=n->free_next;
+            n->free_next=rec->free;
+            rec->free=n;
+            ++rec->free_count;
+        }
+    }
+
+    //把退休时间不晚于e-2的limbo桶移到空闲链表
+    void collect(ThreadRecord* rec,uint64_t e){
+        for(int i=0;i<3;++i){
+            if(rec->limbo[i]&&rec->limbo_epoch[i]+2<=e)
+                splice_free(rec,rec->limbo[i]);
+        }
+        if(rec->free_count>2*batch_size)
+            give_batch(rec);
+    }
+
+    //必须在head的CAS成功之后调用：按此时的全局epoch（而不是本线程登记的、可能落后的epoch）给节点打标记
+    void retire(ThreadRecord* rec,Node<T>* node){
+        uint64_t e=global_epoch.load(std::memory_order_acquire);
+        int b=static_cast<int>(e%3);
+        if(rec->limbo_epoch[b]!=e){
+            //桶里是e-3或更早退休的节点，全局epoch已经不小于e，可以直接重用
+            splice_free(rec,rec->limbo[b]);
+            rec->limbo_epoch[b]=e;
+        }
+        node->free_next=rec->limbo[b];
+        rec->limbo[b]=node;
+        if(++rec->retired%advance_interval==0)
+            try_advance();
+    }
+
+    void give_batch(ThreadRecord* rec){
+        Node<T>* first=rec->free;
+        Node<T>* last=first;
+        for(size_t i=1;i<batch_size;++i)
+            last=last->free_next;
+        rec->free=last->free_next;
+        rec->free_count-=batch_size;
+        std::lock_guard<std::mutex>lock(pool_mutex);
+        last->free_next=pool;
+        pool=first;
+    }
+
+    void take_batch(ThreadRecord* rec){
+        std::lock_guard<std::mutex>lock(pool_mutex);
+        for(size_t i=0;i<batch_size&&pool;++i){
+            Node<T>* n=pool;
+            pool=n->free_next;
+            n->free_next=rec->free;
+            rec->free=n;
+            ++rec->free_count;
+        }
+    }
+
+    Node<T>* allocate(ThreadRecord* rec){
+        if(!rec->free)
+            take_batch(rec);
+        if(!rec->free){
+            try_advance();
+            collect(rec,global_epoch.load());
+        }
+        if(!rec->free)
+            return new Node<T>;
+        Node<T>* n=rec->free;
+        rec->free=n->free_next;
+        --rec->free_count;
+        n->next.store(nullptr,std::memory_order_relaxed);
+        return n;
+    }
+
+    static void delete_list(Node<T>* list){
+        while(list){
+            Node<T>* n=list;
+            list=n->free_next;
+            delete n;
+        }
+    }
+
+public:
+    LockFreeQueue():head(new Node<T>),tail(head.load()),id(next_id()){}
+    LockFreeQueue(const LockFreeQueue&)=delete;
+    LockFreeQueue& operator=(const LockFreeQueue&)=delete;
+
+    //析构时不能再有其他线程访问队列
+    ~LockFreeQueue(){
+        Node<T>* dummy=head.load();
+        Node<T>* n=dummy->next.load();
+        delete dummy;//头节点是哑节点，其中没有数据
+        while(n){
+            Node<T>* next=n->next.load();
+            n->value()->~T();
+            delete n;
+            n=next;
+        }
+        ThreadRecord* rec=records.load();
+        while(rec){
+            ThreadRecord* next=rec->next;
+            for(int i=0;i<3;++i)
+                delete_list(rec->limbo[i]);
+            delete_list(rec->free);
+            delete rec;
+            rec=next;
+        }
+        delete_list(pool);
+    }
+
+    void Enqueue(T value){
+        ThreadRecord* rec=enter();
+        Node<T>* newNode=allocate(rec);
+        ::new(static_cast<void*>(newNode->storage))T(std::move(value));
+
+        while(true){
+            Node<T>* oldTail=tail.load();//读取tail指针值
+            Node<T>* next=oldTail->next.load();//读取oldtail节点的next指针值，EBR保证oldTail此时不会被回收
+            if(oldTail==tail.load()){//检查oldtail时候仍然指向当前tail节点，如果不是，说明tail指针已被其他线程更新来，需要重新尝试
+                if(next==nullptr){//next指针为nullptr，说明oldtail是队列的最后一个节点
+                    if(oldTail->next.compare_exchange_strong(next,newNode)){//尝试使用CAS操作将oldtail的next指针更新为新创建的newnode
+                        tail.compare_exchange_strong(oldTail,newNode);//尝试使用 CAS 操作将 tail 指针更新为新添加的 newNode。
+                        leave(rec);
+                        return;
+                    }
+                }
+                else{
+                    tail.compare_exchange_strong(oldTail,next);//如果next指针不为nullptr，说明oldtail已经不再是最后一个节点，
+                                                                //需要先更新tail为next
+                }
+            }
+        }
+    }
+
+    /*
+        出队成功时把数据移动到out中并返回true，队列为空时返回false
+        head成功从oldHead移动到next之后，next成为新的哑节点，它的数据只属于这次出队的线程；
+        即使其他线程紧接着把next也出队并退休，EBR保证在本线程离开临界区之前next不会被重用
+    */
+    bool try_dequeue(T& out){
+        ThreadRecord* rec=enter();
+        while(true){
+            Node<T>* oldHead=head.load();//获取头指针
+            Node<T>* oldTail=tail.load();//获取尾指针
+            Node<T>* next=oldHead->next.load();//头指针的next指针值存储在next变量中
+
+            if(oldHead==head.load()){//检查 oldHead 是否仍然指向当前的 head 节点。
+                if(oldHead==oldTail){//指向同一个节点，说明队列为空或tail落后了
+                    if(next==nullptr){
+                        leave(rec);
+                        return false;
+                    }
+                    tail.compare_exchange_strong(oldTail,next);
+                    //如果 next 不为 nullptr，说明tail落后了,需要更新 tail 指针为 next。
+                }
+                else if(next!=nullptr){
+                    if(head.compare_exchange_strong(oldHead,next)){
+                        T* value=next->value();
+                        out=std::move(*value);
+                        value->~T();
+                        retire(rec,oldHead);//旧的哑节点交给EBR，等待安全时重用
+                        leave(rec);
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+
+    //兼容原来的接口，需要额外为返回值分配一次shared_ptr；性能敏感的地方使用try_dequeue
+    std::shared_ptr<T>Dequeue(){
+        T value;
+        if(try_dequeue(value))
+            return std::make_shared<T>(std::move(value));
+        return std::shared_ptr<T>();//队列为空，返回一个空的std::shared_ptr<T>()
+    }
+};
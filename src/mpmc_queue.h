@@ -0,0 +1,231 @@
+#pragma once
+#include<atomic>
+#include<cstddef>
+#include<memory>
+#include<new>
+#include<utility>
+#include<stdexcept>
+#include<iterator>
+#include"wait_policy.h"
+
+/*
+    有界多生产者多消费者环形队列（Dmitry Vyukov的MPMC bounded queue）
+
+    * 容量在构造时确定（向上取整到2的幂），所有槽位一次性分配，之后不再分配内存
+    * 每个槽位有自己的序号seq，按缓存行对齐，相邻槽位之间没有伪共享：
+        seq==pos      槽位空闲，位置pos的生产者可以写入
+        seq==pos+1    槽位已写入，位置pos的消费者可以读取
+        读取之后seq置为pos+capacity，即下一圈的生产者可以写入
+    * 生产者只在enqueue_pos上做一次CAS抢位置，消费者只在dequeue_pos上做一次CAS，
+      生产者和消费者之间只通过各自槽位的seq同步
+    * push_n/pop_n一次CAS抢占连续的多个位置，批量写入/读取
+    * 阻塞的push/pop在队列满/空时按WaitPolicy等待（默认先自旋再用futex睡眠，见wait_policy.h），
+      对方只有在确实有线程睡眠时才发出唤醒的系统调用
+*/
+
+template<typename T>
+class MPMCQueue{
+    private:
+        static constexpr size_t cache_line=64;
+
+        struct alignas(cache_line) Slot{
+            std::atomic<size_t>seq;
+            alignas(T) unsigned char storage[sizeof(T)];
+            T* value(){return std::launder(reinterpret_cast<T*>(storage));}
+        };
+
+        const size_t mask;
+        std::unique_ptr<Slot[]>slots;
+        alignas(cache_line) std::atomic<size_t>enqueue_pos{0};//生产者和消费者的位置分别放在不同的缓存行
+        alignas(cache_line) std::atomic<size_t>dequeue_pos{0};
+        alignas(cache_line) ParkingSpot not_empty;//等待元素的消费者
+        ParkingSpot not_full;//等待空位的生产者
+        WaitPolicy policy;
+
+        static size_t round_up(size_t n){
+            size_t c=2;
+            while(c<n)
+                c<<=1;
+            return c;
+        }
+
+        //抢占[pos,pos+k)共最多max个连续的空闲位置，返回k（可能为0）
+        size_t claim_push(size_t max,size_t& pos){
+            pos=enqueue_pos.load(std::memory_order_relaxed);
+            while(true){
+                size_t k=0;
+                while(k<max){
+                    size_t seq=slots[(pos+k)&mask].seq.load(std::memory_order_acquire);
+                    if(seq!=pos+k)
+                        break;
+                    ++k;
+                }
+                if(k==0){
+                    size_t seq=slots[pos&mask].seq.load(std::memory_order_acquire);
+                    if(static_cast<std::ptrdiff_t>(seq-pos)<0)
+                        return 0;//槽位还没有被上一圈的消费者读走，队列已满
+                    pos=enqueue_pos.load(std::memory_order_relaxed);//其他生产者已经抢走了这个位置
+                    continue;
+                }
+                if(enqueue_pos.compare_exchange_weak(pos,pos+k,std::memory_order_relaxed))
+                    return k;
+            }
+        }
+
+        //抢占[pos,pos+k)共最多max个连续的已写入位置，返回k（可能为0）
+        size_t claim_pop(size_t max,size_t& pos){
+            pos=dequeue_pos.load(std::memory_order_relaxed);
+            while(true){
+                size_t k=0;
+                while(k<max){
+                    size_t seq=slots[(pos+k)&mask].seq.load(std::memory_order_acquire);
+                    if(seq!=pos+k+1)
+                        break;
+                    ++k;
+                }
+                if(k==0){
+                    size_t seq=slots[pos&mask].seq.load(std::memory_order_acquire);
+                    if(static_cast<std::ptrdiff_t>(seq-(pos+1))<0)
+                        return 0;//槽位还没有被写入，队列为空
+                    pos=dequeue_pos.load(std::memory_order_relaxed);
+                    continue;
+                }
+                if(dequeue_pos.compare_exchange_weak(pos,pos+k,std::memory_order_relaxed))
+                    return k;
+            }
+        }
+
+        template<typename U>
+        void publish(size_t pos,U&& value){
+            Slot& slot=slots[pos&mask];
+            ::new(static_cast<void*>(slot.storage))T(std::forward<U>(value));
+            slot.seq.store(pos+1,std::memory_order_release);
+        }
+
+        T consume(size_t pos){
+            Slot& slot=slots[pos&mask];
+            T* p=slot.value();
+            T value(std::move(*p));
+            p->~T();
+            slot.seq.store(pos+mask+1,std::memory_order_release);
+            return value;
+        }
+
+        //阻塞操作等待时检查的条件：队首/队尾的槽位是否可能可用（只读，不抢占）
+        bool can_push()const{
+            size_t pos=enqueue_pos.load(std::memory_order_relaxed);
+            return static_cast<std::ptrdiff_t>(slots[pos&mask].seq.load(std::memory_order_acquire)-pos)>=0;
+        }
+
+        bool can_pop()const{
+            size_t pos=dequeue_pos.load(std::memory_order_relaxed);
+            return static_cast<std::ptrdiff_t>(slots[pos&mask].seq.load(std::memory_order_acquire)-(pos+1))>=0;
+        }
+
+    public:
+        explicit MPMCQueue(size_t capacity,WaitPolicy wait=WaitPolicy::adaptive())
+            :mask(round_up(capacity)-1),slots(new Slot[mask+1]),policy(wait){
+            if(capacity==0)
+                throw std::invalid_argument("MPMCQueue capacity must be positive");
+            for(size_t i=0;i<=mask;++i)
+                slots[i].seq.store(i,std::memory_order_relaxed);
+        }
+        MPMCQueue(const MPMCQueue&)=delete;
+        MPMCQueue& operator=(const MPMCQueue&)=delete;
+
+        //析构时不能再有其他线程访问队列
+        ~MPMCQueue(){
+            size_t end=enqueue_pos.load(std::memory_order_relaxed);
+            for(size_t pos=dequeue_pos.load(std::memory_order_relaxed);pos!=end;++pos)
+                slots[pos&mask].value()->~T();
+        }
+
+        size_t capacity()const{return mask+1;}
+
+        template<typename U>
+        bool try_push(U&& value){
+            size_t pos;
+            if(claim_push(1,pos)==0)
+                return false;
+            publish(pos,std::forward<U>(value));
+            not_empty.notify(1);
+            return true;
+        }
+
+        bool try_pop(T& out){
+            size_t pos;
+            if(claim_pop(1,pos)==0)
+                return false;
+            out=consume(pos);
+            not_full.notify(1);
+            return true;
+        }
+
+        template<typename U>
+        void push(U&& value){
+            size_t pos;
+            while(claim_push(1,pos)==0)
+                wait_until(not_full,policy,[this]{return can_push();});
+            publish(pos,std::forward<U>(value));
+            not_empty.notify(1);
+        }
+
+        void pop(T& out){
+            size_t pos;
+            while(claim_pop(1,pos)==0)
+                wait_until(not_empty,policy,[this]{return can_pop();});
+            out=consume(pos);
+            not_full.notify(1);
+        }
+
+        //从first开始移动最多n个元素入队，返回实际入队的个数，不阻塞
+        template<typename It>
+        size_t try_push_n(It first,size_t n){
+            if(n==0)
+                return 0;
+            size_t pos;
+            size_t k=claim_push(n,pos);
+            for(size_t i=0;i<k;++i,++first)
+                publish(pos+i,std::move(*first));
+            not_empty.notify(k);
+            return k;
+        }
+
+        //最多出队n个元素写到out开始的位置，返回实际出队的个数，不阻塞
+        template<typename It>
+        size_t try_pop_n(It out,size_t n){
+            if(n==0)
+                return 0;
+            size_t pos;
+            size_t k=claim_pop(n,pos);
+            for(size_t i=0;i<k;++i,++out)
+                *out=consume(pos+i);
+            not_full.notify(k);
+            return k;
+        }
+
+        //n个元素全部入队后才返回
+        template<typename It>
+        void push_n(It first,size_t n){
+            while(n>0){
+                size_t k=try_push_n(first,n);
+                if(k==0){
+                    wait_until(not_full,policy,[this]{return can_push();});
+                    continue;
+                }
+                std::advance(first,k);
+                n-=k;
+            }
+        }
+
+        //阻塞到至少有一个元素，然后最多出队n个，返回出队的个数
+        template<typename It>
+        size_t pop_n(It out,size_t n){
+            if(n==0)
+                return 0;
+            size_t k;
+            while((k=try_pop_n(out,n))==0)
+                wait_until(not_empty,policy,[this]{return can_pop();});
+            return k;
+        }
+};
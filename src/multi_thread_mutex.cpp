@@ -1,21 +1,29 @@
 #include<iostream>
 #include<vector>
 #include<thread>
-#include<mutex>
+#include"sharded_counter.h"
 
+/*
+    最初的实现用一个std::mutex保护int count_，每次++都要加锁，所有线程都排队争抢同一个缓存行：
+        void inrement(){
+            std::lock_guard<std::mutex>lock(mutex_);
+            ++count_;
+        }
+    现在改用分片计数器（sharded_counter.h）：每个线程只对自己的槽位做relaxed原子加，读的时候再求和
+*/
 class SharedCounter{
     private:
-        mutable std::mutex mutex_;//当一个成员变量声明为mutable时，意味着成员变量可以被任何方法修改，即使这个方法是const类型的
-                                    //这是因为mutable关键字可以打破const类型的限制，使得const类型的方法也可以修改成员变量的值。
-        int count_=0;
+        ShardedCounter count_;
     public:
         void inrement(){
-            std::lock_guard<std::mutex>lock(mutex_);
-            ++count_;
+            count_.increment();
         }
         int getCount()const{
-            std::lock_guard<std::mutex>lock(mutex_);
-            return count_;
+            return static_cast<int>(count_.getCount());
+        }
+        //近似值，开销只有一次原子读，适合频繁读取
+        int getApproxCount()const{
+            return static_cast<int>(count_.getApproxCount());
         }
 };
 
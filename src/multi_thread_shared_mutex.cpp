@@ -29,26 +29,38 @@ unlock_shared：解锁以共享模式锁定的互斥。
 #include<string>
 #include<thread>
 #include<vector>
-#include<boost/thread/shared_mutex.hpp>
+#include"concurrent_map.h"
+#include"distributed_shared_mutex.h"
+#include"async_logger.h"
+
+/*
+    最初的实现用一个boost::shared_mutex保护整个std::unordered_map，每次write都会挡住所有key的读。
+    现在改用分段锁并发哈希表（concurrent_map.h）：每个分段有自己的shared_mutex，只有哈希到同一分段的读写才会互相影响。
+    StringHash和std::equal_to<>支持异构查找，read可以直接用std::string_view查找，不需要构造新的std::string
+    每个分段的锁是DistributedSharedMutex（distributed_shared_mutex.h）：读者只在自己线程的槽位上计数，
+    读多写少时读者之间不再争抢同一个读者计数
+    输出改用异步日志（async_logger.h）：visit在读锁内只把value拷贝进当前线程的日志缓冲区，不再在锁内执行std::cout
+*/
 class SharedData{
     private:
-        mutable boost::shared_mutex mutex_;
-        std::unordered_map<std::string,std::string>data_;
+        ConcurrentHashMap<std::string,std::string,StringHash,std::equal_to<>,DistributedSharedMutex>data_;
     public:
-        void read(const std::string& key)const{
-            boost::shared_lock<boost::shared_mutex>lock(mutex_);
-            auto it=data_.find(key);
-            if(it!=data_.end()){
-                std::cout<<"Thread:"<<std::this_thread::get_id()<<"read"<<it->second<<std::endl;
-            }else{
-                std::cout<<"Key not find"<<std::endl;
+        void read(std::string_view key)const{
+            bool found=data_.visit(key,[](const std::string& value){
+                async_log().log("Thread:{}read{}",std::this_thread::get_id(),value);
+            });
+            if(!found){
+                async_log().log("Key not find");
             }
         }
 
         void write(const std::string& key,const std::string& value){
-            boost::unique_lock<boost::shared_mutex>lock(mutex_);
-            data_[key]=value;
-            std::cout<<"Thread:"<<std::this_thread::get_id()<<"wrote"<<value<<std::endl;
+            data_.insert_or_assign(key,value);
+            async_log().log("Thread:{}wrote{}",std::this_thread::get_id(),value);
+        }
+
+        bool erase(std::string_view key){
+            return data_.erase(key);
         }
 };
 
@@ -0,0 +1,248 @@
+#pragma once
+#include<algorithm>
+#include<atomic>
+#include<condition_variable>
+#include<cstddef>
+#include<exception>
+#include<functional>
+#include<iterator>
+#include<memory>
+#include<mutex>
+#include<optional>
+#include<thread>
+#include<type_traits>
+#include<vector>
+#include"thread_pool.h"
+
+/*
+    基于ThreadPool的并行算法：parallel_for / parallel_reduce / parallel_sort
+
+    区间划分：
+    * 把[first,last)切成若干块（chunk），块数 = min(n/min_grain, 参与线程数*chunks_per_thread)，
+      数据少时块少（任务开销不超过计算本身），数据多时每个线程能分到多块（快慢不均时可以互相补位）
+    * 调用线程自己也参与计算：向线程池提交最多pool.size()个helper，所有参与者用一个原子计数依次领取块
+    * 调用线程只等待"所有块完成"，不等待helper启动。在工作线程内部调用也不会死锁：
+      即使helper一直排在队列里，调用线程也会自己把所有块做完
+    * 块中抛出的异常在所有块结束后由调用线程重新抛出（第一个异常）
+    parallel_reduce中每个参与者把领到的块累加到自己的槽位，不存在共享的原子累加
+*/
+
+namespace parallel_detail{
+
+constexpr size_t min_grain=2048;//自动划分时每块的最少元素数
+constexpr size_t chunks_per_thread=4;
+
+//一次并行调用的共享状态；helper可能在调用返回之后才开始执行，因此用shared_ptr保存
+struct Job{
+    size_t n;
+    size_t grain;
+    size_t chunks;
+    std::atomic<size_t>next{0};
+    std::atomic<size_t>done{0};
+    std::atomic<bool>failed{false};
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable finished;
+
+    Job(size_t n,size_t grain):n(n),grain(grain),chunks((n+grain-1)/grain){}
+
+    void fail(std::exception_ptr e){
+        std::lock_guard<std::mutex>lock(mutex);
+        if(!error)
+            error=e;
+        failed.store(true,std::memory_order_relaxed);
+    }
+
+    //把k个块记为完成；最后一块完成时唤醒调用线程
+    void complete(size_t k){
+        if(k==0)
+            return;
+        if(done.fetch_add(k)+k==chunks){
+            std::lock_guard<std::mutex>lock(mutex);
+            finished.notify_all();
+        }
+    }
+
+    void wait(){
+        std::unique_lock<std::mutex>lock(mutex);
+        finished.wait(lock,[this]{return done.load()==chunks;});
+        if(error)
+            std::rethrow_exception(error);
+    }
+};
+
+//grain为0时根据元素数和线程数自动选择块大小
+inline size_t choose_grain(size_t n,size_t participants,size_t grain){
+    if(grain>0)
+        return grain;
+    size_t target=participants*chunks_per_thread;
+    size_t g=(n+target-1)/target;
+    return std::max(g,min_grain);
+}
+
+/*
+    按块执行body(participant,begin,end)，participant是参与者编号（0是调用线程）。
+    每个参与者领不到新块时才把自己处理过的块一次性记为完成
+*/
+template<class Body>
+void run_chunks(ThreadPool& pool,size_t n,size_t grain,Body body){
+    if(n==0)
+        return;
+    auto job=std::make_shared<Job>(n,choose_grain(n,pool.size()+1,grain));
+    auto work=[job,body](size_t participant)mutable{
+        size_t processed=0;
+        for(;;){
+            size_t c=job->next.fetch_add(1,std::memory_order_relaxed);
+            if(c>=job->chunks)
+                break;
+            ++processed;
+            if(job->failed.load(std::memory_order_relaxed))
+                continue;//已经有块失败，剩下的块只计数不执行
+            size_t begin=c*job->grain;
+            size_t end=std::min(begin+job->grain,job->n);
+            try{
+                body(participant,begin,end);
+            }catch(...){
+                job->fail(std::current_exception());
+            }
+        }
+        job->complete(processed);
+    };
+    size_t helpers=std::min(pool.size(),job->chunks-1);
+    for(size_t i=1;i<=helpers;++i)
+        pool.post([work,i]()mutable{work(i);});
+    work(0);
+    job->wait();
+}
+
+inline size_t participants(ThreadPool& pool){return pool.size()+1;}
+
+//归并有序的a[0,na)和b[0,nb)时，输出的前k个元素中有多少个来自a（相等时先取a，和std::merge一致）
+template<class It,class Compare>
+size_t merge_split(It a,size_t na,It b,size_t nb,size_t k,Compare& comp){
+    size_t lo=k>nb?k-nb:0,hi=std::min(k,na);
+    while(lo<hi){
+        size_t i=lo+(hi-lo)/2,j=k-i;
+        if(j>0&&i<na&&!comp(b[j-1],a[i]))
+            lo=i+1;
+        else
+            hi=i;
+    }
+    return lo;
+}
+
+//把src中[b,m)和[m,e)两段归并后的第[k0,k1)个元素写到dst+b+k0；各片互不重叠，可以并行执行
+template<class Src,class Dst,class Compare>
+void merge_piece(Src src,Dst dst,size_t b,size_t m,size_t e,size_t k0,size_t k1,Compare& comp){
+    Src a=src+b,c=src+m;
+    size_t na=m-b,nc=e-m;
+    size_t i0=merge_split(a,na,c,nc,k0,comp),i1=merge_split(a,na,c,nc,k1,comp);
+    std::merge(std::make_move_iterator(a+i0),std::make_move_iterator(a+i1),
+               std::make_move_iterator(c+(k0-i0)),std::make_move_iterator(c+(k1-i1)),
+               dst+b+k0,comp);
+}
+
+}
+
+//对[first,last)中的每个元素调用f（随机访问迭代器）；grain为每块的元素数，0表示自动选择
+template<class It,class F,class=std::enable_if_t<!std::is_integral<It>::value>>
+void parallel_for(ThreadPool& pool,It first,It last,F f,size_t grain=0){
+    size_t n=static_cast<size_t>(std::distance(first,last));
+    parallel_detail::run_chunks(pool,n,grain,
+        [first,&f](size_t,size_t begin,size_t end){
+            for(It it=first+begin,stop=first+end;it!=stop;++it)
+                f(*it);
+        });
+}
+
+//对下标区间[begin,end)的每个i调用f(i)
+template<class F>
+void parallel_for(ThreadPool& pool,size_t begin,size_t end,F f,size_t grain=0){
+    parallel_detail::run_chunks(pool,end>begin?end-begin:0,grain,
+        [begin,&f](size_t,size_t b,size_t e){
+            for(size_t i=begin+b;i<begin+e;++i)
+                f(i);
+        });
+}
+
+/*
+    和std::reduce相同的语义：结果为init与所有元素按op合并，op需要满足结合律和交换律
+    每个参与者只累加到自己的（按缓存行对齐的）槽位，调用线程在所有块完成后合并所有槽位
+*/
+template<class It,class T,class Op=std::plus<>>
+T parallel_reduce(ThreadPool& pool,It first,It last,T init,Op op=Op{},size_t grain=0){
+    size_t n=static_cast<size_t>(std::distance(first,last));
+    struct alignas(64) Partial{
+        std::optional<T>value;
+    };
+    //每个参与者的累加值，只有该参与者访问；调用线程在所有块完成后才读取
+    std::vector<Partial>partials(parallel_detail::participants(pool));
+    parallel_detail::run_chunks(pool,n,grain,
+        [first,&op,&partials](size_t p,size_t begin,size_t end){
+            It it=first+begin,stop=first+end;
+            T acc=*it;
+            for(++it;it!=stop;++it)
+                acc=op(std::move(acc),*it);
+            std::optional<T>& local=partials[p].value;
+            if(local)
+                local=op(std::move(*local),std::move(acc));
+            else
+                local.emplace(std::move(acc));
+        });
+    for(Partial& partial:partials){
+        if(partial.value)
+            init=op(std::move(init),std::move(*partial.value));
+    }
+    return init;
+}
+
+/*
+    并行归并排序：
+    1. 把区间分成若干段，用parallel_for并行地对每段做std::sort
+    2. 每轮把相邻的两段归并成一段，在原数组和临时缓冲区之间交替，直到只剩一段
+    3. 后面几轮的段数少于线程数，只按对并行的话最后一轮就是整个数组的串行归并，加速比不超过2倍；
+       所以每对再按输出位置切成若干片，每片用二分查找（merge_split）找到两段中对应的起点，各片独立归并
+    排序不稳定（第一步用的是std::sort）
+*/
+template<class It,class Compare=std::less<>>
+void parallel_sort(ThreadPool& pool,It first,It last,Compare comp=Compare{}){
+    using Value=typename std::iterator_traits<It>::value_type;
+    size_t n=static_cast<size_t>(std::distance(first,last));
+    size_t runs=1;
+    while(runs<parallel_detail::participants(pool)*2&&n/(runs*2)>=parallel_detail::min_grain)
+        runs*=2;
+    if(runs==1){
+        std::sort(first,last,comp);
+        return;
+    }
+    size_t width=(n+runs-1)/runs;
+    parallel_for(pool,size_t(0),runs,[&](size_t r){
+        size_t b=std::min(r*width,n),e=std::min(b+width,n);
+        std::sort(first+b,first+e,comp);
+    },1);
+
+    std::vector<Value>buffer(std::make_move_iterator(first),std::make_move_iterator(last));
+    //数据当前在buffer中，每轮归并写到另一边
+    bool in_buffer=true;
+    size_t workers=parallel_detail::participants(pool);
+    for(;width<n;width*=2){
+        size_t pairs=(n+2*width-1)/(2*width);
+        //每对切成pieces片，片数让任务数不少于参与者数，但每片不少于min_grain个元素
+        size_t pieces=std::max<size_t>(1,std::min((workers+pairs-1)/pairs,2*width/parallel_detail::min_grain));
+        size_t piece=(2*width+pieces-1)/pieces;
+        parallel_for(pool,size_t(0),pairs*pieces,[&](size_t t){
+            size_t p=t/pieces,q=t%pieces;
+            size_t b=p*2*width,m=std::min(b+width,n),e=std::min(b+2*width,n);
+            size_t k0=std::min(q*piece,e-b),k1=std::min(k0+piece,e-b);
+            if(k0==k1)
+                return;
+            if(in_buffer)
+                parallel_detail::merge_piece(buffer.begin(),first,b,m,e,k0,k1,comp);
+            else
+                parallel_detail::merge_piece(first,buffer.begin(),b,m,e,k0,k1,comp);
+        },1);
+        in_buffer=!in_buffer;
+    }
+    if(in_buffer)
+        std::move(buffer.begin(),buffer.end(),first);
+}
@@ -0,0 +1,384 @@
+#pragma once
+#include<atomic>
+#include<condition_variable>
+#include<exception>
+#include<future>
+#include<memory>
+#include<mutex>
+#include<optional>
+#include<stdexcept>
+#include<tuple>
+#include<type_traits>
+#include<utility>
+#include<variant>
+#include<vector>
+#include"thread_pool.h"
+#include"task.h"
+
+/*
+    线程池感知的future：PoolFuture<T>
+
+    std::future只能用get()阻塞等待，等待期间占住一个线程。PoolFuture在结果就绪时把后续工作直接提交到线程池：
+    * pool_async(pool,f,args...)：在线程池中执行f，返回PoolFuture
+    * fut.then(g)：结果就绪后在线程池中执行g(value)（PoolFuture<void>时执行g()），返回新的PoolFuture；
+      前一步抛出的异常直接传给下一步，不会调用g
+    * when_all(f1,f2,...)/when_all(vector)：全部完成后就绪，得到tuple/vector；任何一个失败则整体失败
+    * when_any(vector)：第一个完成的结果，得到{下标,值}
+    * get()/wait()仍然可以阻塞等待，用在整个流水线的最末端
+    PoolFuture只能移动；then、get以及组合函数都会消耗掉原来的future
+    PoolPromise在设置结果之前被销毁时，future以std::future_error(broken_promise)失败
+*/
+
+//void结果在内部用std::monostate表示，这样when_all的tuple中也可以包含void
+template<class T>
+using pool_value_t=std::conditional_t<std::is_void<T>::value,std::monostate,T>;
+
+template<class T>
+class PoolFuture;
+
+namespace detail{
+
+template<class T>
+struct FutureState{
+    using value_type=pool_value_t<T>;
+
+    std::mutex mutex;
+    std::condition_variable ready_cv;
+    bool ready=false;
+    std::optional<value_type>value;
+    std::exception_ptr error;
+    //结果就绪时需要执行的回调；run_inline为false的回调提交到线程池
+    std::vector<std::pair<Task,bool>>callbacks;
+    ThreadPool* pool;
+
+    explicit FutureState(ThreadPool* pool):pool(pool){}
+
+    //调用者必须在整个调用期间持有state的shared_ptr：get()返回后等待者可能立即释放它持有的引用
+    template<class Set>
+    void complete(Set&& set){
+        std::vector<std::pair<Task,bool>>pending;
+        {
+            std::lock_guard<std::mutex>lock(mutex);
+            if(ready)
+                throw std::logic_error("PoolFuture result already set");
+            set();
+            ready=true;
+            pending.swap(callbacks);
+            ready_cv.notify_all();//在锁内通知，等待者醒来时complete已经不再访问ready_cv
+        }
+        for(auto& cb:pending)
+            dispatch(std::move(cb.first),cb.second);
+    }
+
+    void set_value(value_type v){complete([&]{value.emplace(std::move(v));});}
+    void set_exception(std::exception_ptr e){complete([&]{error=std::move(e);});}
+
+    void dispatch(Task t,bool run_inline){
+        if(run_inline)
+            t();
+        else
+            pool->post(std::move(t));
+    }
+
+    //注册回调：结果已经就绪时立即执行（或提交），否则等complete时执行
+    void subscribe(Task t,bool run_inline){
+        {
+            std::lock_guard<std::mutex>lock(mutex);
+            if(!ready){
+                callbacks.emplace_back(std::move(t),run_inline);
+                return;
+            }
+        }
+        dispatch(std::move(t),run_inline);
+    }
+
+    void wait(){
+        std::unique_lock<std::mutex>lock(mutex);
+        ready_cv.wait(lock,[this]{return ready;});
+    }
+
+    //只能在就绪之后调用一次
+    value_type take(){
+        if(error)
+            std::rethrow_exception(error);
+        return std::move(*value);
+    }
+};
+
+//执行f并把结果或异常写入state
+//只有f在try里：set_value本身（例如向已经停止的线程池提交后续任务）抛出时不能再对已就绪的state调用set_exception
+template<class R,class F,class... A>
+void fulfill(FutureState<R>& state,F& f,A&&... a){
+    std::optional<pool_value_t<R>>result;
+    std::exception_ptr error;
+    try{
+        if constexpr(std::is_void<R>::value){
+            f(std::forward<A>(a)...);
+            result.emplace();
+        }else{
+            result.emplace(f(std::forward<A>(a)...));
+        }
+    }catch(...){
+        error=std::current_exception();
+    }
+    if(error)
+        state.set_exception(std::move(error));
+    else
+        state.set_value(std::move(*result));
+}
+
+//组合函数和pool_async通过它访问PoolFuture内部的共享状态
+struct FutureAccess{
+    template<class T>
+    static std::shared_ptr<FutureState<T>>& state(PoolFuture<T>& f){return f.state;}
+    template<class T>
+    static PoolFuture<T>make(std::shared_ptr<FutureState<T>>s){return PoolFuture<T>(std::move(s));}
+
+    //结果就绪时在完成它的线程上直接执行f(state)，并消耗掉这个future
+    template<class T,class F>
+    static void on_ready(PoolFuture<T>& fut,F&& f){
+        auto s=std::move(fut.state);
+        s->subscribe(Task([s,f=std::forward<F>(f)]()mutable{f(*s);}),true);
+    }
+};
+
+}
+
+template<class T>
+class PoolFuture{
+    private:
+        std::shared_ptr<detail::FutureState<T>>state;
+
+        template<class U> friend class PoolFuture;
+        template<class U> friend class PoolPromise;
+        friend struct detail::FutureAccess;
+
+        explicit PoolFuture(std::shared_ptr<detail::FutureState<T>>s):state(std::move(s)){}
+
+    public:
+        PoolFuture()=default;
+        PoolFuture(PoolFuture&&)noexcept=default;
+        PoolFuture& operator=(PoolFuture&&)noexcept=default;
+        PoolFuture(const PoolFuture&)=delete;
+        PoolFuture& operator=(const PoolFuture&)=delete;
+
+        bool valid()const{return state!=nullptr;}
+
+        bool is_ready()const{
+            std::lock_guard<std::mutex>lock(state->mutex);
+            return state->ready;
+        }
+
+        void wait()const{state->wait();}
+
+        //阻塞到结果就绪；只应在流水线末端或者线程池之外调用
+        T get(){
+            auto s=std::move(state);
+            s->wait();
+            if constexpr(std::is_void<T>::value)
+                s->take();
+            else
+                return s->take();
+        }
+
+        //结果就绪后在线程池中执行f，返回f结果的PoolFuture
+        template<class F>
+        auto then(F&& f){
+            using R=typename std::conditional_t<std::is_void<T>::value,
+                std::invoke_result<std::decay_t<F>>,
+                std::invoke_result<std::decay_t<F>,T>>::type;
+            auto src=std::move(state);
+            auto dst=std::make_shared<detail::FutureState<R>>(src->pool);
+            src->subscribe(Task([src,dst,fn=std::forward<F>(f)]()mutable{
+                if(src->error){
+                    dst->set_exception(src->error);
+                    return;
+                }
+                if constexpr(std::is_void<T>::value)
+                    detail::fulfill(*dst,fn);
+                else
+                    detail::fulfill(*dst,fn,std::move(*src->value));
+            }),false);
+            return PoolFuture<R>(std::move(dst));
+        }
+};
+
+//手动设置结果的一端，用来把外部事件接入PoolFuture
+template<class T>
+class PoolPromise{
+    private:
+        std::shared_ptr<detail::FutureState<T>>state;
+
+        //还没有设置结果时以broken_promise异常完成，否则get()会永远阻塞，等待中的回调也不会释放
+        void abandon()noexcept{
+            auto s=std::move(state);
+            if(!s)
+                return;
+            {
+                std::lock_guard<std::mutex>lock(s->mutex);
+                if(s->ready)
+                    return;
+            }
+            try{
+                s->set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+            }catch(...){
+                //线程池已经停止时后续任务无法提交，只能丢弃
+            }
+        }
+
+    public:
+        explicit PoolPromise(ThreadPool& pool):state(std::make_shared<detail::FutureState<T>>(&pool)){}
+        PoolPromise(PoolPromise&&)noexcept=default;
+        PoolPromise(const PoolPromise&)=delete;
+        PoolPromise& operator=(const PoolPromise&)=delete;
+
+        PoolPromise& operator=(PoolPromise&& other)noexcept{
+            if(this!=&other){
+                abandon();
+                state=std::move(other.state);
+            }
+            return *this;
+        }
+
+        ~PoolPromise(){
+            abandon();
+        }
+
+        PoolFuture<T>get_future(){return detail::FutureAccess::make(state);}
+
+        //先把state复制到局部变量：结果就绪后future一端可能释放最后一个外部引用，complete期间state必须保持有效
+        template<class U=T,class=std::enable_if_t<!std::is_void<U>::value>>
+        void set_value(U value){
+            auto s=state;
+            s->set_value(std::move(value));
+        }
+
+        template<class U=T,class=std::enable_if_t<std::is_void<U>::value>>
+        void set_value(){
+            auto s=state;
+            s->set_value(std::monostate{});
+        }
+
+        void set_exception(std::exception_ptr e){
+            auto s=state;
+            s->set_exception(std::move(e));
+        }
+};
+
+template<class F,class... Args>
+auto pool_async(ThreadPool& pool,F&& f,Args&&... args)
+    ->PoolFuture<std::invoke_result_t<std::decay_t<F>,std::decay_t<Args>...>>{
+    using R=std::invoke_result_t<std::decay_t<F>,std::decay_t<Args>...>;
+    auto state=std::make_shared<detail::FutureState<R>>(&pool);
+    pool.post([state,fn=std::forward<F>(f),tup=std::make_tuple(std::forward<Args>(args)...)]()mutable{
+        std::apply([&](auto&... a){detail::fulfill(*state,fn,std::move(a)...);},tup);
+    });
+    return detail::FutureAccess::make(std::move(state));
+}
+
+namespace detail{
+
+template<size_t... I,class F>
+void for_each_index(std::index_sequence<I...>,F&& f){
+    (f(std::integral_constant<size_t,I>{}),...);
+}
+
+}
+
+//所有future完成后就绪；任何一个失败时整体以第一个异常失败
+template<class... Ts>
+PoolFuture<std::tuple<pool_value_t<Ts>...>>when_all(PoolFuture<Ts>... futures){
+    using Result=std::tuple<pool_value_t<Ts>...>;
+    static_assert(sizeof...(Ts)>0,"when_all needs at least one future");
+    struct Join{
+        std::tuple<std::optional<pool_value_t<Ts>>...>values;
+        std::atomic<size_t>remaining{sizeof...(Ts)};
+        std::mutex error_mutex;
+        std::exception_ptr error;
+    };
+    ThreadPool* pool=detail::FutureAccess::state(std::get<0>(std::tie(futures...)))->pool;
+    auto out=std::make_shared<detail::FutureState<Result>>(pool);
+    auto join=std::make_shared<Join>();
+    auto attach=[&](auto index,auto& fut){
+        detail::FutureAccess::on_ready(fut,[out,join](auto& s){
+            if(s.error){
+                std::lock_guard<std::mutex>lock(join->error_mutex);
+                if(!join->error)
+                    join->error=s.error;
+            }else{
+                std::get<decltype(index)::value>(join->values).emplace(std::move(*s.value));
+            }
+            if(join->remaining.fetch_sub(1)!=1)
+                return;
+            if(join->error){
+                out->set_exception(join->error);
+                return;
+            }
+            out->set_value(std::apply([](auto&... v){return Result(std::move(*v)...);},join->values));
+        });
+    };
+    detail::for_each_index(std::index_sequence_for<Ts...>{},[&](auto index){
+        attach(index,std::get<decltype(index)::value>(std::tie(futures...)));
+    });
+    return detail::FutureAccess::make(std::move(out));
+}
+
+template<class T>
+PoolFuture<std::vector<pool_value_t<T>>>when_all(std::vector<PoolFuture<T>>futures){
+    using Result=std::vector<pool_value_t<T>>;
+    if(futures.empty())
+        throw std::invalid_argument("when_all needs at least one future");
+    struct Join{
+        std::vector<std::optional<pool_value_t<T>>>values;
+        std::atomic<size_t>remaining;
+        std::mutex error_mutex;
+        std::exception_ptr error;
+        explicit Join(size_t n):values(n),remaining(n){}
+    };
+    auto out=std::make_shared<detail::FutureState<Result>>(detail::FutureAccess::state(futures.front())->pool);
+    auto join=std::make_shared<Join>(futures.size());
+    for(size_t i=0;i<futures.size();++i){
+        detail::FutureAccess::on_ready(futures[i],[out,join,i](detail::FutureState<T>& s){
+            if(s.error){
+                std::lock_guard<std::mutex>lock(join->error_mutex);
+                if(!join->error)
+                    join->error=s.error;
+            }else{
+                join->values[i].emplace(std::move(*s.value));
+            }
+            if(join->remaining.fetch_sub(1)!=1)
+                return;
+            if(join->error){
+                out->set_exception(join->error);
+                return;
+            }
+            Result result;
+            result.reserve(join->values.size());
+            for(auto& v:join->values)
+                result.push_back(std::move(*v));
+            out->set_value(std::move(result));
+        });
+    }
+    return detail::FutureAccess::make(std::move(out));
+}
+
+//第一个完成（成功或失败）的future决定结果，得到它的下标和值
+template<class T>
+PoolFuture<std::pair<size_t,pool_value_t<T>>>when_any(std::vector<PoolFuture<T>>futures){
+    using Result=std::pair<size_t,pool_value_t<T>>;
+    if(futures.empty())
+        throw std::invalid_argument("when_any needs at least one future");
+    auto out=std::make_shared<detail::FutureState<Result>>(detail::FutureAccess::state(futures.front())->pool);
+    auto won=std::make_shared<std::atomic<bool>>(false);
+    for(size_t i=0;i<futures.size();++i){
+        detail::FutureAccess::on_ready(futures[i],[out,won,i](detail::FutureState<T>& s){
+            if(won->exchange(true))
+                return;
+            if(s.error)
+                out->set_exception(s.error);
+            else
+                out->set_value(Result(i,std::move(*s.value)));
+        });
+    }
+    return detail::FutureAccess::make(std::move(out));
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include<atomic>
+#include<chrono>
+#include<cstddef>
+#include<cstdint>
+#include<iomanip>
+#include<ostream>
+#include<vector>
+#include"hdr_histogram.h"
+
+/*
+    ThreadPool的运行时指标（定义THREAD_POOL_METRICS时才会编译进线程池，见thread_pool.h）
+
+    * 每个工作线程有一份自己的WorkerMetrics（按缓存行对齐），只有该线程写：
+      执行的任务数、窃取次数、在condition上睡眠的时间（idle），以及排队时间（提交到开始执行）和执行时间的直方图
+    * 写入只是relaxed原子变量的load+store，不加锁、不做RMW，也不碰队列锁；
+      任务数先累加在工作线程的本地计数里，每flush_interval个任务（以及睡眠、退出之前）才发布一次，
+      stats()看到的任务数最多落后每个工作线程flush_interval-1个
+    * 每个任务读三次时钟的开销和一个很短的任务本身差不多，因此排队时间和执行时间是抽样的：
+      提交方每sample_period个任务给一个任务打上提交时间（存放在Task对齐留下的stamp中，队列元素仍然是64字节），
+      enqueue_bulk每批只抽样第一个任务；只有带时间戳的任务才计时并记录到直方图，百分位不受抽样影响
+    * busy时间 = 线程存活时间 - 睡眠时间（包括取任务的开销），不需要给每个任务计时；
+      只有在ParkingSpot上真正睡眠的时间计为idle，自旋、让出阶段的等待计入busy（spinning()策略下idle始终为0）
+    * stats()随时可以在任何线程调用，把所有工作线程的指标汇总成一个PoolStats快照（各个计数之间不保证完全一致）
+*/
+
+namespace pool_metrics{
+
+constexpr unsigned sample_period=64;//必须是2的幂
+constexpr unsigned flush_interval=64;//本地计数发布到原子计数的间隔（任务数）
+
+inline uint64_t now_ns(){
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+//提交一个任务时调用：被抽中的任务返回当前时间，其余返回0
+inline uint64_t sample_enqueue(){
+    static thread_local unsigned submitted=0;
+    return (submitted++&(sample_period-1))==0?now_ns():0;
+}
+
+//单写者计数器的累加：只有拥有者线程调用，其他线程只读
+inline void add(std::atomic<uint64_t>& counter,uint64_t v){
+    counter.store(counter.load(std::memory_order_relaxed)+v,std::memory_order_relaxed);
+}
+
+struct alignas(64) WorkerMetrics{
+    std::atomic<uint64_t>tasks{0};
+    std::atomic<uint64_t>steals{0};
+    std::atomic<uint64_t>idle_ns{0};
+    std::atomic<uint64_t>sleeping_since{0};//正在睡眠时为开始睡眠的时间，否则为0；stats()据此计入还没有结束的睡眠
+    uint64_t started_ns=now_ns();
+    HdrHistogram wait_ns;
+    HdrHistogram exec_ns;
+    //只有拥有者线程访问的本地计数，还没有发布到tasks
+    unsigned local_tasks=0;
+
+    //窃取本身就要加锁，次数也少，直接发布；任务数每flush_interval个发布一次
+    void count(bool stolen){
+        if(stolen)
+            add(steals,1);
+        if(++local_tasks==flush_interval){
+            add(tasks,flush_interval);
+            local_tasks=0;
+        }
+    }
+
+    void flush(){
+        if(local_tasks==0)
+            return;
+        add(tasks,local_tasks);
+        local_tasks=0;
+    }
+};
+
+}
+
+struct PoolWorkerStats{
+    uint64_t tasks;
+    uint64_t steals;
+    uint64_t busy_ns;
+    uint64_t idle_ns;
+};
+
+struct PoolStats{
+    size_t queue_depth;//尚未开始执行的任务数（不含post_at中还没有到期的任务）
+    size_t idle_workers;//正在睡眠的工作线程数
+    uint64_t tasks;
+    uint64_t steals;
+    uint64_t busy_ns;
+    uint64_t idle_ns;
+    std::vector<PoolWorkerStats>workers;
+    HdrHistogram queue_wait_ns;
+    HdrHistogram exec_ns;
+
+    //工作线程没有睡眠的时间所占的比例，接近1说明线程池已经饱和
+    double utilization()const{
+        uint64_t total=busy_ns+idle_ns;
+        return total?static_cast<double>(busy_ns)/total:0.0;
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& os,const PoolStats& s){
+    std::ios_base::fmtflags flags=os.flags();
+    std::streamsize precision=os.precision();
+    os<<"tasks="<<s.tasks<<" steals="<<s.steals<<" queue_depth="<<s.queue_depth
+      <<" idle_workers="<<s.idle_workers<<" utilization="<<std::fixed<<std::setprecision(3)<<s.utilization()
+      <<" wait_ns(p50/p99/max)="<<s.queue_wait_ns.percentile(50)<<'/'<<s.queue_wait_ns.percentile(99)<<'/'<<s.queue_wait_ns.max()
+      <<" exec_ns(p50/p99/max)="<<s.exec_ns.percentile(50)<<'/'<<s.exec_ns.percentile(99)<<'/'<<s.exec_ns.max();
+    os.flags(flags);
+    os.precision(precision);
+    return os;
+}
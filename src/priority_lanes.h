@@ -0,0 +1,116 @@
+#pragma once
+#include<algorithm>
+#include<chrono>
+#include<cstddef>
+#include<cstdint>
+#include<deque>
+#include<utility>
+#include<vector>
+
+/*
+    ThreadPool全局队列使用的多优先级队列（本身不是线程安全的，由queue_mutex保护）
+
+    * 每个优先级一条FIFO通道（deque），另有一条最早截止时间优先（EDF）通道，按deadline组成最小堆
+    * 通道的选择顺序：EDF > High > Normal > Low；用一个位掩码记录哪些通道非空，
+      取任务时用一条ctz指令找到最高的非空通道，选择本身是O(1)（EDF通道出堆是O(log n)）
+    * 防止饥饿：非空的通道每被更高的通道抢先一次，它的计数加一；
+      计数达到starvation_limit时下一次直接从这条通道取一个任务，然后清零。
+      因此即使高优先级任务一直不断，低优先级任务也至少能得到1/(starvation_limit+1)的执行机会
+*/
+
+enum class Priority{High,Normal,Low};
+
+template<class T>
+class PriorityLanes{
+    private:
+        static constexpr unsigned deadline_lane=0;
+        static constexpr unsigned lane_count=4;//EDF、High、Normal、Low
+
+        struct DeadlineItem{
+            std::chrono::steady_clock::time_point deadline;
+            uint64_t seq;//deadline相同时按提交顺序
+            T item;
+        };
+
+        static bool later(const DeadlineItem& a,const DeadlineItem& b){
+            return a.deadline!=b.deadline?a.deadline>b.deadline:a.seq>b.seq;
+        }
+
+        std::deque<T>lanes[lane_count];//lanes[deadline_lane]不使用
+        std::vector<DeadlineItem>deadlines;
+        uint64_t next_seq=0;
+        unsigned nonempty=0;//第i位表示第i条通道非空
+        unsigned skipped[lane_count]={};
+        unsigned starvation_limit;
+        size_t count=0;
+        size_t urgent_count=0;//EDF和High通道中的任务数
+
+        static unsigned lane_of(Priority p){return static_cast<unsigned>(p)+1;}
+
+        bool take(unsigned lane,T& out){
+            if(lane==deadline_lane){
+                std::pop_heap(deadlines.begin(),deadlines.end(),later);
+                out=std::move(deadlines.back().item);
+                deadlines.pop_back();
+                if(deadlines.empty())
+                    nonempty&=~(1u<<lane);
+            }else{
+                out=std::move(lanes[lane].front());
+                lanes[lane].pop_front();
+                if(lanes[lane].empty())
+                    nonempty&=~(1u<<lane);
+            }
+            --count;
+            if(lane<=lane_of(Priority::High))
+                --urgent_count;
+            return true;
+        }
+
+    public:
+        explicit PriorityLanes(unsigned starvation_limit=32):starvation_limit(starvation_limit){}
+
+        void set_starvation_limit(unsigned limit){starvation_limit=limit;}
+
+        void push(Priority p,T item){
+            unsigned lane=lane_of(p);
+            lanes[lane].push_back(std::move(item));
+            nonempty|=1u<<lane;
+            ++count;
+            if(p==Priority::High)
+                ++urgent_count;
+        }
+
+        void push(std::chrono::steady_clock::time_point deadline,T item){
+            deadlines.push_back(DeadlineItem{deadline,next_seq++,std::move(item)});
+            std::push_heap(deadlines.begin(),deadlines.end(),later);
+            nonempty|=1u<<deadline_lane;
+            ++count;
+            ++urgent_count;
+        }
+
+        bool pop(T& out){
+            if(nonempty==0)
+                return false;
+            unsigned lane=static_cast<unsigned>(__builtin_ctz(nonempty));
+            unsigned lower=nonempty&~((2u<<lane)-1);//比lane优先级低的非空通道
+            if(lower){
+                //从最低的优先级开始，找已经被抢先足够多次的通道
+                for(unsigned l=lane_count-1;l>lane;--l){
+                    if((lower>>l)&1u&&skipped[l]>=starvation_limit){
+                        skipped[l]=0;
+                        return take(l,out);
+                    }
+                }
+                for(unsigned l=lane+1;l<lane_count;++l){
+                    if((lower>>l)&1u)
+                        ++skipped[l];
+                }
+            }
+            skipped[lane]=0;
+            return take(lane,out);
+        }
+
+        bool empty()const{return count==0;}
+        size_t size()const{return count;}
+        size_t urgent()const{return urgent_count;}
+};
@@ -11,75 +11,125 @@
     pthread_mutex_t 实际上是一个互斥锁（mutex）对象。它用于创建和管理多线程程序中的互斥锁。
     互斥锁是同步原语，允许多个线程协调工作，确保在任何时刻只有一个线程可以访问关键代码段或共享资源。
     这可以防止在多个线程同时尝试访问相同资源时发生冲突和数据损坏。
+
+    最初的实现用两个sem_t、一个pthread_mutex_t、一个条件变量和std::list<int>：
+    每个元素都要经过两次信号量系统调用、一次加锁，并且list为每个元素分配一个节点。
+    现在缓冲区换成有界无锁MPMC环形队列（mpmc_queue.h），容量固定为BUFFER_SIZE，
+    生产者和消费者的数量可以通过命令行参数设置：
+        producer-consumer [生产者数量] [消费者数量] [每个生产者生产的个数]
+    只有一个生产者和一个消费者时改用单生产者单消费者通道（spsc_channel.h），不需要任何CAS
+    进度输出交给异步日志（async_logger.h）：生产者和消费者只把参数拷贝到自己线程的缓冲区，格式化和写出由后台线程完成
 */
 
 #include<iostream>
-#include<semaphore.h>
-#include<pthread.h>
-#include<list>
-#include<unistd.h>
+#include<thread>
+#include<vector>
+#include<atomic>
+#include<string>
+#include<cstdlib>
+#include"mpmc_queue.h"
+#include"spsc_channel.h"
+#include"async_logger.h"
 #define BUFFER_SIZE 10
+#define BATCH_SIZE 4
 
-sem_t emptySlots;
-sem_t fullSlots;
-pthread_mutex_t mutex;
-pthread_cond_t cond_consumer;
-std::list<int> buffers;
+MPMCQueue<int> buffers(BUFFER_SIZE);
+SPSCChannel<int> channel(BUFFER_SIZE);
+std::atomic<long long> consumed_sum{0};
+const int SENTINEL=-1;//生产的元素都不小于0；所有生产者结束后为每个消费者放入一个，消费者取到后退出
 
-void* producer(void* arg){
-    for(int i=0;i<20;i++){
-        sem_wait(&emptySlots);//等待有空位,请求信号量，若信号量的值大于0，则将其减1并继续执行，否则当前线程将被阻塞值扫信号量的值变为大于0
-        pthread_mutex_lock(&mutex);
-        buffers.push_back(i);
-        std::cout<<"Produced:"<<i<<std::endl;
-        pthread_mutex_unlock(&mutex);
-        pthread_cond_signal(&cond_consumer);//通知消费者有新的数据
-        sem_post(&fullSlots);//释放信号量，将信号量的值加1(数据加一)
-        usleep(1000000);
+void producer(int id,int count){
+    //每次批量提交BATCH_SIZE个元素，一次CAS抢占连续的槽位
+    int batch[BATCH_SIZE];
+    for(int i=0;i<count;){
+        int n=0;
+        while(n<BATCH_SIZE&&i<count)
+            batch[n++]=i++;
+        buffers.push_n(batch,n);
+        async_log().log("Producer {} produced {} items, last:{}",id,n,batch[n-1]);
     }
-    return nullptr;
 }
 
-void* consumer(void* arg){
-    for(int i=0;i<20;i++){
-        sem_wait(&fullSlots);
-        pthread_mutex_lock(&mutex);
-        while(buffers.empty()){
-            pthread_cond_wait(&cond_consumer,&mutex);
+//队列为空时在pop_n中按WaitPolicy阻塞等待
+void consumer(int id){
+    int batch[BATCH_SIZE];
+    long long sum=0;
+    while(true){
+        size_t n=buffers.pop_n(batch,BATCH_SIZE);
+        size_t items=0;
+        while(items<n&&batch[items]!=SENTINEL)
+            sum+=batch[items++];
+        if(items>0)
+            async_log().log("Consumer {} consumed {} items, first:{}",id,items,batch[0]);
+        if(items<n){
+            //哨兵排在所有元素之后；一次多取到的哨兵放回去留给其他消费者
+            if(n-items>1)
+                buffers.push_n(batch+items+1,n-items-1);
+            break;
         }
-        int item=buffers.front();
-        buffers.pop_front();
-        std::cout<<"Consumed:"<<item<<std::endl;
-        pthread_mutex_unlock(&mutex);
-        sem_post(&emptySlots);//增加空槽位
-        usleep(150000);
     }
-    return nullptr;
+    consumed_sum.fetch_add(sum);
 }
 
-int main(){
-    sem_init(&emptySlots,0,BUFFER_SIZE);
-    sem_init(&fullSlots,0,0);
-    pthread_mutex_init(&mutex,nullptr);
-    pthread_cond_init(&cond_consumer,nullptr);
-
-    pthread_t prod,cons;
+//一对一的情况：生产者每BATCH_SIZE个元素commit一次，消费者阻塞等待，只有通道空/满时才进入内核
+void spsc_producer(int count){
+    for(int i=0;i<count;){
+        int n=0;
+        while(n<BATCH_SIZE&&i<count){
+            if(!channel.try_stage(i))
+                channel.emplace(i);//通道已满：先发布已经stage的元素，再等待消费者腾出空间
+            ++n;
+            ++i;
+        }
+        channel.commit();
+        async_log().log("Producer 0 produced {} items, last:{}",n,i-1);
+    }
+}
 
-    pthread_create(&prod,nullptr,producer,nullptr);
-    pthread_create(&cons,nullptr,consumer,nullptr);
-    /*
-    请注意，pthread_create 函数的第一个参数是指向线程标识符的指针，
-    第二个参数是线程属性（通常使用 nullptr 表示默认属性），
-    第三个参数是线程的入口函数，最后一个参数是传递给线程入口函数的参数。
-    */
-   pthread_join(prod,nullptr);
-   pthread_join(cons,nullptr);
+void spsc_consumer(int count){
+    int batch[BATCH_SIZE];
+    long long sum=0;
+    while(count>0){
+        size_t n=channel.pop_n(batch,BATCH_SIZE);
+        count-=static_cast<int>(n);
+        for(size_t i=0;i<n;++i)
+            sum+=batch[i];
+        async_log().log("Consumer 0 consumed {} items, first:{}",n,batch[0]);
+    }
+    consumed_sum.fetch_add(sum);
+}
 
-   sem_destroy(&emptySlots);
-   sem_destroy(&fullSlots);
+int main(int argc,char* argv[]){
+    int producers=argc>1?std::atoi(argv[1]):1;
+    int consumers=argc>2?std::atoi(argv[2]):1;
+    int per_producer=argc>3?std::atoi(argv[3]):20;
+    if(producers<=0||consumers<=0||per_producer<0){
+        std::cerr<<"usage: producer-consumer [producers] [consumers] [items per producer]"<<std::endl;
+        return 1;
+    }
 
-   pthread_mutex_destroy(&mutex);
-   pthread_cond_destroy(&cond_consumer);
+    if(producers==1&&consumers==1){
+        std::thread p(spsc_producer,per_producer);
+        std::thread c(spsc_consumer,per_producer);
+        p.join();
+        c.join();
+    }
+    else{
+        std::vector<std::thread> producer_threads,consumer_threads;
+        for(int i=0;i<producers;++i)
+            producer_threads.emplace_back(producer,i,per_producer);
+        for(int i=0;i<consumers;++i)
+            consumer_threads.emplace_back(consumer,i);
+        for(std::thread& t:producer_threads)
+            t.join();
+        for(int i=0;i<consumers;++i)
+            buffers.push(SENTINEL);
+        for(std::thread& t:consumer_threads)
+            t.join();
+    }
 
-   return 0;
-}
\ No newline at end of file
+    async_log().flush();//先写出所有进度日志，再直接输出结果
+    long long expected=static_cast<long long>(producers)*per_producer*(per_producer-1)/2;
+    std::cout<<"consumed sum: "<<consumed_sum.load()<<" expected: "<<expected<<std::endl;
+    return consumed_sum.load()==expected?0:1;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include<atomic>
+#include<cstddef>
+#include<memory>
+#include<thread>
+
+/*
+    分片计数器
+
+    所有线程对同一个计数（无论是加锁还是std::atomic）做++时，这个计数所在的缓存行会在各个核之间来回传递。
+    ShardedCounter把计数分成多个按缓存行对齐的槽位：
+    * 每个线程第一次使用时轮流分到一个槽位，之后只对自己的槽位做relaxed的fetch_add，线程数不超过槽位数时互不干扰
+    * getCount()把所有槽位加起来，读的开销和槽位数成正比
+    * getApproxCount()只读一个原子变量：每个槽位每累计flush_threshold次就把这部分汇总到approx_中，
+      结果比真实值小，误差不超过 槽位数*flush_threshold，适合频繁读取（例如监控）
+*/
+
+class ShardedCounter{
+    private:
+        static constexpr size_t cache_line=64;
+        static constexpr unsigned long flush_threshold=1024;
+
+        struct alignas(cache_line) Slot{
+            std::atomic<unsigned long>value{0};
+        };
+
+        const size_t mask;
+        std::unique_ptr<Slot[]>slots;
+        alignas(cache_line) std::atomic<unsigned long>approx_{0};
+
+        static size_t default_shards(){
+            size_t n=std::thread::hardware_concurrency();
+            return n==0?8:n;
+        }
+
+        static size_t round_up(size_t n){
+            size_t c=1;
+            while(c<n)
+                c<<=1;
+            return c;
+        }
+
+        //线程第一次使用计数器时分配一个编号，之后一直使用同一个槽位
+        static size_t thread_index(){
+            static std::atomic<size_t>next{0};
+            static thread_local size_t index=0;//0表示还没有分配，常量初始化的thread_local访问时不需要检查初始化标志
+            if(index==0)
+                index=next.fetch_add(1,std::memory_order_relaxed)+1;
+            return index;
+        }
+
+    public:
+        explicit ShardedCounter(size_t shards=default_shards()):mask(round_up(shards)-1),slots(new Slot[mask+1]){}
+        ShardedCounter(const ShardedCounter&)=delete;
+        ShardedCounter& operator=(const ShardedCounter&)=delete;
+
+        void increment(unsigned long n=1){
+            Slot& slot=slots[thread_index()&mask];
+            unsigned long old=slot.value.fetch_add(n,std::memory_order_relaxed);
+            if((old%flush_threshold)+n>=flush_threshold){//跨过了flush_threshold的整数倍
+                unsigned long crossed=(old+n)/flush_threshold-old/flush_threshold;
+                approx_.fetch_add(crossed*flush_threshold,std::memory_order_relaxed);
+            }
+        }
+
+        //精确值：所有槽位之和。与increment并发时返回的是某个中间时刻附近的值
+        unsigned long getCount()const{
+            unsigned long sum=0;
+            for(size_t i=0;i<=mask;++i)
+                sum+=slots[i].value.load(std::memory_order_relaxed);
+            return sum;
+        }
+
+        //近似值：只读一个原子变量，不大于getCount()，误差不超过shards()*flush_threshold
+        unsigned long getApproxCount()const{
+            return approx_.load(std::memory_order_relaxed);
+        }
+
+        size_t shards()const{return mask+1;}
+};
@@ -0,0 +1,196 @@
+#pragma once
+#include<atomic>
+#include<cstddef>
+#include<memory>
+#include<new>
+#include<stdexcept>
+#include<utility>
+#include"wait_policy.h"
+
+/*
+    单生产者单消费者环形通道
+
+    只有一个线程写、一个线程读时，不需要任何CAS或锁：
+    * tail只由生产者修改，head只由消费者修改，两者放在不同的缓存行
+    * 生产者缓存一份head（cached_head），只有缓存的值显示通道已满时才去读真正的head；
+      消费者同样缓存一份tail。大部分操作只访问本方的缓存行
+    * 生产者可以先stage多个元素（直接在槽位中原地构造），再用commit()一次release store把它们全部发布；
+      消费者的pop_n同样只用一次store归还槽位
+    * front()直接返回槽位中元素的指针，消费者可以原地读取后再pop()
+    * push/pop在通道满/空时按WaitPolicy等待（默认先自旋，仍然不满足才用futex挂起，见wait_policy.h）；
+      对方只有在看到有线程真正挂起时才发出唤醒的系统调用，通道不满不空时不会进入内核
+*/
+
+template<typename T>
+class SPSCChannel{
+    private:
+        static constexpr size_t cache_line=64;
+
+        struct Slot{
+            alignas(T) unsigned char storage[sizeof(T)];
+            T* value(){return std::launder(reinterpret_cast<T*>(storage));}
+        };
+
+        const size_t mask;
+        std::unique_ptr<Slot[]>slots;
+
+        //生产者的缓存行
+        alignas(cache_line) std::atomic<size_t>tail{0};
+        size_t staged=0;//已经构造但还没有commit的位置，staged>=tail
+        size_t cached_head=0;
+
+        //消费者的缓存行
+        alignas(cache_line) std::atomic<size_t>head{0};
+        size_t cached_tail=0;
+
+        //挂起等待时使用，只在通道满/空或有线程挂起时访问
+        alignas(cache_line) ParkingSpot not_empty;
+        ParkingSpot not_full;
+        WaitPolicy policy;
+
+        static size_t round_up(size_t n){
+            size_t c=2;
+            while(c<n)
+                c<<=1;
+            return c;
+        }
+
+        bool has_space(){
+            if(staged-cached_head<=mask)
+                return true;
+            cached_head=head.load(std::memory_order_acquire);
+            return staged-cached_head<=mask;
+        }
+
+        size_t readable(){
+            size_t h=head.load(std::memory_order_relaxed);
+            if(cached_tail==h)
+                cached_tail=tail.load(std::memory_order_acquire);
+            return cached_tail-h;
+        }
+
+    public:
+        explicit SPSCChannel(size_t capacity,WaitPolicy wait=WaitPolicy::adaptive())
+            :mask(round_up(capacity)-1),slots(new Slot[mask+1]),policy(wait){
+            if(capacity==0)
+                throw std::invalid_argument("SPSCChannel capacity must be positive");
+        }
+        SPSCChannel(const SPSCChannel&)=delete;
+        SPSCChannel& operator=(const SPSCChannel&)=delete;
+
+        //析构时不能再有其他线程访问通道
+        ~SPSCChannel(){
+            for(size_t pos=head.load();pos!=staged;++pos)
+                slots[pos&mask].value()->~T();
+        }
+
+        size_t capacity()const{return mask+1;}
+
+        //以下接口只能由生产者线程调用
+
+        //在下一个空闲槽位中原地构造元素，但暂不发布；通道已满时返回false
+        template<typename... Args>
+        bool try_stage(Args&&... args){
+            if(!has_space())
+                return false;
+            ::new(static_cast<void*>(slots[staged&mask].storage))T(std::forward<Args>(args)...);
+            ++staged;
+            return true;
+        }
+
+        //一次release store发布所有stage过的元素
+        void commit(){
+            if(staged==tail.load(std::memory_order_relaxed))
+                return;
+            tail.store(staged,std::memory_order_release);
+            not_empty.notify(1);//发布新的位置后，如果消费者已经挂起则唤醒它
+        }
+
+        template<typename... Args>
+        bool try_emplace(Args&&... args){
+            if(!try_stage(std::forward<Args>(args)...))
+                return false;
+            commit();
+            return true;
+        }
+
+        template<typename... Args>
+        void emplace(Args&&... args){
+            if(!has_space()){
+                commit();//已经stage的元素必须先发布，否则消费者永远不会腾出空间
+                wait_until(not_full,policy,[this]{return has_space();});
+            }
+            try_emplace(std::forward<Args>(args)...);
+        }
+
+        void push(T value){emplace(std::move(value));}
+
+        //从first开始移动n个元素，全部写入后一次发布（通道空间不足时分多次发布）
+        template<typename It>
+        void push_n(It first,size_t n){
+            for(size_t i=0;i<n;++i,++first){
+                if(!try_stage(std::move(*first)))
+                    emplace(std::move(*first));//空间不足时先发布已经stage的元素，等待消费者腾出空间
+            }
+            commit();
+        }
+
+        //以下接口只能由消费者线程调用
+
+        //返回队首元素的指针，通道为空时返回nullptr；元素在pop()之前一直有效
+        T* front(){
+            if(readable()==0)
+                return nullptr;
+            return slots[head.load(std::memory_order_relaxed)&mask].value();
+        }
+
+        //丢弃队首元素，必须在front()返回非空之后调用
+        void pop(){
+            size_t h=head.load(std::memory_order_relaxed);
+            slots[h&mask].value()->~T();
+            head.store(h+1,std::memory_order_release);
+            not_full.notify(1);
+        }
+
+        bool try_pop(T& out){
+            T* p=front();
+            if(!p)
+                return false;
+            out=std::move(*p);
+            pop();
+            return true;
+        }
+
+        void pop(T& out){
+            wait_until(not_empty,policy,[this]{return readable()!=0;});
+            try_pop(out);
+        }
+
+        //最多取出n个元素写到out开始的位置，一次store归还所有槽位，返回取出的个数，不阻塞
+        template<typename It>
+        size_t try_pop_n(It out,size_t n){
+            size_t k=readable();
+            if(k>n)
+                k=n;
+            if(k==0)
+                return 0;
+            size_t h=head.load(std::memory_order_relaxed);
+            for(size_t i=0;i<k;++i,++out){
+                T* p=slots[(h+i)&mask].value();
+                *out=std::move(*p);
+                p->~T();
+            }
+            head.store(h+k,std::memory_order_release);
+            not_full.notify(1);
+            return k;
+        }
+
+        //阻塞到至少有一个元素，然后最多取出n个
+        template<typename It>
+        size_t pop_n(It out,size_t n){
+            if(n==0)
+                return 0;
+            wait_until(not_empty,policy,[this]{return readable()!=0;});
+            return try_pop_n(out,n);
+        }
+};
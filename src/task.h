@@ -0,0 +1,122 @@
+#pragma once
+#include<cstddef>
+#include<cstdint>
+#include<new>
+#include<type_traits>
+#include<utility>
+
+/*
+    Task：只能移动的void()可调用对象包装，用来替代线程池队列里的std::function<void()>
+    * std::function要求可调用对象可拷贝，因此std::packaged_task这类只能移动的对象必须先放进shared_ptr
+    * Task内部有一块inline_size字节的缓冲区，能放下的可调用对象直接在缓冲区里构造（small buffer optimization），不分配堆内存
+    * 放不下（或移动构造可能抛异常）的才退回到new分配
+    * 缓冲区和ops_之后对齐留下的8字节存放一个stamp，线程池开启指标时用它记录抽样任务的提交时间
+    整个对象正好占一条64字节的缓存行
+*/
+class Task{
+    public:
+        static constexpr std::size_t inline_size=48;
+
+        Task()noexcept=default;
+
+        template<class F,class=typename std::enable_if<
+            !std::is_same<typename std::decay<F>::type,Task>::value>::type>
+        Task(F&& f){
+            using Fn=typename std::decay<F>::type;
+            if constexpr(fits_inline<Fn>()){
+                ::new(static_cast<void*>(buffer_))Fn(std::forward<F>(f));
+                ops_=&inline_ops<Fn>;
+            }else{
+                ::new(static_cast<void*>(buffer_))Fn*(new Fn(std::forward<F>(f)));
+                ops_=&heap_ops<Fn>;
+            }
+        }
+
+        Task(Task&& other)noexcept{
+            move_from(other);
+        }
+
+        Task& operator=(Task&& other)noexcept{
+            if(this!=&other){
+                reset();
+                move_from(other);
+            }
+            return *this;
+        }
+
+        Task(const Task&)=delete;
+        Task& operator=(const Task&)=delete;
+
+        ~Task(){
+            reset();
+        }
+
+        explicit operator bool()const noexcept{
+            return ops_!=nullptr;
+        }
+
+        void operator()(){
+            ops_->invoke(buffer_);
+        }
+
+        //附加在任务上的64位标记，随任务一起移动；不影响调用
+        std::uint64_t stamp()const noexcept{return stamp_;}
+        void set_stamp(std::uint64_t stamp)noexcept{stamp_=stamp;}
+
+        //可调用对象是否存放在内部缓冲区中（不需要堆分配）
+        template<class F>
+        static constexpr bool fits_inline(){
+            return sizeof(F)<=inline_size
+                && alignof(F)<=alignof(std::max_align_t)
+                && std::is_nothrow_move_constructible<F>::value;
+        }
+
+    private:
+        //手写的虚函数表：每种可调用类型对应一个静态的Ops实例
+        struct Ops{
+            void(*invoke)(void*);
+            void(*move)(void* dst,void* src)noexcept;//把src中的对象移动到dst，并销毁src中的对象
+            void(*destroy)(void*)noexcept;
+        };
+
+        template<class Fn>
+        static constexpr Ops inline_ops{
+            [](void* p){(*static_cast<Fn*>(p))();},
+            [](void* dst,void* src)noexcept{
+                ::new(dst)Fn(std::move(*static_cast<Fn*>(src)));
+                static_cast<Fn*>(src)->~Fn();
+            },
+            [](void* p)noexcept{static_cast<Fn*>(p)->~Fn();}
+        };
+
+        template<class Fn>
+        static constexpr Ops heap_ops{
+            [](void* p){(**static_cast<Fn**>(p))();},
+            [](void* dst,void* src)noexcept{
+                ::new(dst)Fn*(*static_cast<Fn**>(src));
+            },
+            [](void* p)noexcept{delete *static_cast<Fn**>(p);}
+        };
+
+        void move_from(Task& other)noexcept{
+            stamp_=other.stamp_;
+            if(other.ops_){
+                other.ops_->move(buffer_,other.buffer_);
+                ops_=other.ops_;
+                other.ops_=nullptr;
+            }
+        }
+
+        void reset()noexcept{
+            if(ops_){
+                ops_->destroy(buffer_);
+                ops_=nullptr;
+            }
+        }
+
+        alignas(std::max_align_t) unsigned char buffer_[inline_size];
+        const Ops* ops_=nullptr;
+        std::uint64_t stamp_=0;
+};
+
+static_assert(sizeof(Task)==64||sizeof(void*)!=8,"Task should fill exactly one cache line");
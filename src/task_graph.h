@@ -0,0 +1,220 @@
+#pragma once
+#include<atomic>
+#include<condition_variable>
+#include<cstddef>
+#include<deque>
+#include<exception>
+#include<mutex>
+#include<stdexcept>
+#include<utility>
+#include<vector>
+#include"task.h"
+#include"thread_pool.h"
+
+/*
+    TaskGraph：在ThreadPool上执行的有向无环任务图（DAG）
+
+    多阶段的作业如果写成嵌套的enqueue加future::get()，等待的工作线程什么也不做，线程少时还会死锁。
+    TaskGraph先描述依赖，再整体交给线程池执行：
+        TaskGraph graph;
+        auto a=graph.emplace([]{...});
+        auto b=graph.emplace([]{...});
+        auto c=graph.emplace([]{...});
+        a.precede(b,c);//b和c在a之后执行
+        graph.run(pool);//执行整张图并等待完成，可以重复执行
+    * 每个节点记录依赖数；每次执行开始时pending重置为依赖数，前驱完成时原子地减一，减到0的后继就绪
+    * 就绪的后继由刚完成前驱的工作线程直接调度：第一个就绪的后继在当前线程上接着执行（不经过队列），
+      其余的post到线程池，WorkStealing模式下进入当前工作线程的本地队列，空闲线程可以窃取
+    * 图的结构只在修改之后的第一次执行时检查（有环时抛出std::logic_error）并缓存入度为0的节点；
+      之后重复执行只重置计数，图本身不分配内存，post的任务只捕获两个指针，放在Task的内部缓冲区里
+    * 节点抛出的异常在wait()中重新抛出（第一个异常），之后还没有开始的节点不再执行
+    * 执行期间不能修改图，同一张图同时只能执行一次；不要在单线程的线程池的工作线程内部调用run/wait
+*/
+
+class TaskGraph{
+    private:
+        struct Node{
+            Task work;
+            size_t index;//在nodes中的下标
+            std::vector<Node*>successors;
+            size_t dependencies=0;
+            std::atomic<size_t>pending{0};
+
+            Node(Task work,size_t index):work(std::move(work)),index(index){}
+        };
+
+        std::deque<Node>nodes;//deque在尾部添加元素时不移动已有元素，节点地址保持不变
+        std::vector<Node*>sources;//入度为0的节点，结构变化后重新计算
+        bool dirty=false;
+
+        ThreadPool* pool=nullptr;
+        std::atomic<size_t>remaining{0};
+        std::atomic<bool>failed{false};
+        std::exception_ptr error;
+        bool running=false;
+        std::mutex mutex;
+        std::condition_variable finished;
+
+        //检查有没有环（Kahn算法），并缓存入度为0的节点
+        void prepare(){
+            sources.clear();
+            std::vector<size_t>indegree;
+            std::vector<Node*>ready;
+            indegree.reserve(nodes.size());
+            for(Node& node:nodes){
+                indegree.push_back(node.dependencies);
+                if(node.dependencies==0){
+                    sources.push_back(&node);
+                    ready.push_back(&node);
+                }
+            }
+            size_t visited=0;
+            while(!ready.empty()){
+                Node* node=ready.back();
+                ready.pop_back();
+                ++visited;
+                for(Node* s:node->successors){
+                    if(--indegree[s->index]==0)
+                        ready.push_back(s);
+                }
+            }
+            if(visited!=nodes.size())
+                throw std::logic_error("TaskGraph contains a cycle");
+            dirty=false;
+        }
+
+        void fail(std::exception_ptr e){
+            std::lock_guard<std::mutex>lock(mutex);
+            if(!error)
+                error=e;
+            failed.store(true,std::memory_order_relaxed);
+        }
+
+        void submit(Node* node){
+            pool->post([this,node]{execute(node);});
+        }
+
+        //执行node，然后沿着第一个就绪的后继一直执行下去
+        void execute(Node* node){
+            while(node){
+                if(!failed.load(std::memory_order_relaxed)){
+                    try{
+                        node->work();
+                    }catch(...){
+                        fail(std::current_exception());
+                    }
+                }
+                Node* next=nullptr;
+                for(Node* s:node->successors){
+                    if(s->pending.fetch_sub(1,std::memory_order_acq_rel)==1){
+                        if(next)
+                            submit(s);
+                        else
+                            next=s;
+                    }
+                }
+                //后继都已经调度（或由next持有）之后才计数，remaining到0之前图不会被销毁
+                if(remaining.fetch_sub(1,std::memory_order_acq_rel)==1){
+                    std::lock_guard<std::mutex>lock(mutex);
+                    running=false;
+                    finished.notify_all();
+                }
+                node=next;
+            }
+        }
+
+        void add_edge(Node* from,Node* to){
+            from->successors.push_back(to);
+            ++to->dependencies;
+            dirty=true;
+        }
+
+        void wait_quietly(){
+            std::unique_lock<std::mutex>lock(mutex);
+            finished.wait(lock,[this]{return !running;});
+        }
+
+    public:
+        //节点句柄，只是一个指针，可以随意拷贝；图销毁后失效
+        class NodeRef{
+            private:
+                TaskGraph* graph=nullptr;
+                Node* node=nullptr;
+                NodeRef(TaskGraph* graph,Node* node):graph(graph),node(node){}
+                friend class TaskGraph;
+            public:
+                NodeRef()=default;
+
+                //this在others之前执行
+                template<class... Others>
+                NodeRef& precede(NodeRef other,Others... others){
+                    graph->add_edge(node,other.node);
+                    (graph->add_edge(node,others.node),...);
+                    return *this;
+                }
+
+                //this在others之后执行
+                template<class... Others>
+                NodeRef& succeed(NodeRef other,Others... others){
+                    graph->add_edge(other.node,node);
+                    (graph->add_edge(others.node,node),...);
+                    return *this;
+                }
+
+                bool valid()const{return node!=nullptr;}
+        };
+
+        TaskGraph()=default;
+        TaskGraph(const TaskGraph&)=delete;
+        TaskGraph& operator=(const TaskGraph&)=delete;
+
+        ~TaskGraph(){
+            wait_quietly();
+        }
+
+        //添加一个节点，f是void()的可调用对象，每次执行图时调用一次
+        template<class F>
+        NodeRef emplace(F&& f){
+            nodes.emplace_back(Task(std::forward<F>(f)),nodes.size());
+            dirty=true;
+            return NodeRef(this,&nodes.back());
+        }
+
+        size_t size()const{return nodes.size();}
+        bool empty()const{return nodes.empty();}
+
+        //开始在pool上执行整张图，不等待完成
+        void dispatch(ThreadPool& target){
+            {
+                std::lock_guard<std::mutex>lock(mutex);
+                if(running)
+                    throw std::logic_error("TaskGraph is already running");
+                if(dirty)
+                    prepare();
+                if(nodes.empty())
+                    return;
+                for(Node& node:nodes)
+                    node.pending.store(node.dependencies,std::memory_order_relaxed);
+                error=nullptr;
+                failed.store(false,std::memory_order_relaxed);
+                remaining.store(nodes.size(),std::memory_order_relaxed);
+                pool=&target;
+                running=true;
+            }
+            for(Node* source:sources)//post之前的写入对执行这些任务的线程可见（队列锁）
+                submit(source);
+        }
+
+        //等待本次执行完成，重新抛出节点中的第一个异常
+        void wait(){
+            std::unique_lock<std::mutex>lock(mutex);
+            finished.wait(lock,[this]{return !running;});
+            if(error)
+                std::rethrow_exception(std::exchange(error,nullptr));
+        }
+
+        void run(ThreadPool& target){
+            dispatch(target);
+            wait();
+        }
+};
@@ -0,0 +1,756 @@
+#pragma once
+#include<thread>
+#include<vector>
+#include<queue>
+#include<deque>
+#include<memory>
+#include<atomic>
+#include<functional>
+#include<stdexcept>
+#include<future>
+#include<mutex>
+#include<condition_variable>
+#include<tuple>
+#include<iterator>
+#include<chrono>
+#include<algorithm>
+#include"task.h"
+#include"wait_policy.h"
+#include"cpu_topology.h"
+#include"priority_lanes.h"
+#include"timer_wheel.h"
+#if defined(THREAD_POOL_METRICS)
+#include"pool_metrics.h"
+#endif
+#if defined(__cpp_impl_coroutine)
+#include<coroutine>
+#endif
+
+class ThreadPool{
+    public:
+        /*
+            调度模式
+            SharedQueue：所有任务都经过同一个全局队列，由queue_mutex保护（最初的实现）
+            WorkStealing：每个工作线程拥有自己的双端队列
+                * 在工作线程内部调用enqueue提交的任务进入该线程的本地队列（尾部入队，尾部出队，LIFO，缓存更热）
+                * 外部线程提交的任务仍然进入全局队列
+                * 本地队列和全局队列都为空时，空闲线程从其他线程本地队列的头部窃取任务（FIFO，窃取到的通常是较大的任务）
+            线程数较多且任务很短时，WorkStealing可以避免所有线程争抢同一把queue_mutex
+
+            没有任务时工作线程按WaitPolicy等待（见wait_policy.h）：默认先自旋一小段时间再用futex睡眠，
+            提交方只有在确实有工作线程睡眠时才发出唤醒的系统调用
+
+            Affinity（见cpu_topology.h）可以把工作线程绑定到指定的CPU或每个物理核一个；
+            绑定之后窃取按CPU拓扑排序：先偷同一个物理核/共享LLC的线程，再偷同一NUMA节点的，最后才跨节点
+
+            全局队列分为High/Normal/Low三个优先级和一个最早截止时间优先（EDF）通道（见priority_lanes.h），
+            不指定优先级的任务进入Normal；低优先级的任务不会被饿死
+        */
+        enum class Mode{SharedQueue,WorkStealing};
+    private:
+        //每个工作线程的本地队列，按缓存行对齐，避免相邻队列的锁之间产生伪共享
+        struct alignas(64) WorkerQueue{
+            std::mutex mutex;
+            std::deque<Task>tasks;//WorkStealing模式下的本地任务，可以被窃取
+            std::deque<Task>pinned;//post_to提交的任务，只由这个工作线程执行，不会被窃取
+            std::atomic<size_t>pinned_count{0};//pinned的长度，没有绑定任务时工作线程不需要加锁检查
+            std::vector<size_t>steal_order;//窃取时依次尝试的其他工作线程，按CPU拓扑由近到远
+            int cpu=-1;//绑定的CPU，-1表示没有绑定
+        };
+
+        std::vector<std::thread>workers;
+        PriorityLanes<Task>tasks;//Task可以封装无参数和无返回值的可调用对象，和std::function<void()>类似，但只能移动，
+        //并且小的可调用对象直接存放在Task内部，不需要堆分配（见task.h）
+        std::mutex queue_mutex;
+        std::atomic<bool>stop;
+        Mode mode;
+        WaitPolicy wait_policy;
+        ParkingSpot parking;//空闲的工作线程在这里睡眠
+
+        std::vector<std::unique_ptr<WorkerQueue>>local_queues;
+        std::atomic<size_t>pending{0};//尚未被取走的任务数（全局队列+所有本地队列），工作线程不加锁地检查有没有任务
+        std::atomic<size_t>urgent{0};//全局队列中EDF和High通道的任务数，在queue_mutex内更新；WorkStealing模式下有紧急任务时先取全局队列
+
+        //记录当前线程属于哪个线程池以及它的编号，用于判断enqueue是否是在工作线程内部调用的
+        inline static thread_local ThreadPool* current_pool=nullptr;
+        inline static thread_local size_t current_index=0;
+
+#if defined(THREAD_POOL_METRICS)
+        std::vector<std::unique_ptr<pool_metrics::WorkerMetrics>>metrics;//每个工作线程一份，只有该线程写
+#endif
+
+        /*
+            post_at、schedule_after、schedule_every提交的定时器放在分层时间轮中（见timer_wheel.h），插入和取消都是O(1)；
+            一个定时线程（第一次使用时启动）睡到下一个需要处理的tick，把到期的任务一次性放入任务队列，等待期间不占用工作线程
+        */
+        static constexpr std::chrono::steady_clock::duration timer_tick=std::chrono::milliseconds(1);
+        struct Periodic{
+            Task fn;
+            uint64_t period;//tick数
+            std::atomic<bool>running{false};//上一次还没有执行完时跳过这一次，同一个fn不会同时执行
+        };
+        struct TimerEntry{
+            Task task;//一次性定时器
+            std::shared_ptr<Periodic>periodic;//周期定时器
+        };
+        TimerWheel<TimerEntry>timers;
+        std::chrono::steady_clock::time_point timer_origin=std::chrono::steady_clock::now();
+        uint64_t timer_wakeup=0;//定时线程睡到哪个tick（UINT64_MAX表示没有定时器），醒着时为0
+        std::vector<Task>due;//只由定时线程使用
+        std::mutex timer_mutex;
+        std::condition_variable timer_condition;
+        std::thread timer_thread;
+        bool timer_stop=false;
+
+        void run_shared(size_t index);
+        void run_stealing(size_t index);
+        bool pop_pinned(size_t index,Task& task);
+        bool may_exit(size_t index);
+        bool pop_local(size_t index,Task& task);
+        bool pop_global(Task& task);
+        bool steal(size_t index,Task& task);
+        void execute(size_t index,Task& task,bool stolen);
+        static void sample(Task& task);
+        void push(Task task,Priority priority=Priority::Normal);
+        template<class Key>
+        void push_global(Key key,Task task);
+        template<class It>
+        size_t push_bulk(It first,It last);
+        void wait_for_work(size_t index);
+        void run_timer();
+        uint64_t timer_ticks(std::chrono::steady_clock::time_point t)const;
+        TimerWheel<TimerEntry>::Handle add_timer(uint64_t tick,TimerEntry entry);
+    public:
+        explicit ThreadPool(size_t,Mode mode=Mode::SharedQueue,WaitPolicy wait=WaitPolicy::adaptive(),
+                            Affinity affinity=Affinity::none());
+        /*
+            enqueue函数模板是一个用于将任务添加到线程池的成员函数
+            接收一个可调用对象f和一系列参数args...，并返回一个与f调用结果类型相对应的std::future对象
+            目的：
+            将传递给线程池的任务包装成一个可以异步执行的任务，并返回一个std::future对象，以便可以在需要的时候获取任务的返回值
+
+        */
+        template<class F,class... Args>
+        auto enqueue(F&& f,Args&&... args)
+        -> std::future<typename std::result_of<F(Args...)>::type>;
+        /*
+            std::result_of<F(Args...)>是一个类型萃取表达式，用于推导出f调用的返回类型，
+            会返回F在给定参数Args...下的调用结果类型
+            这意味着 enqueue 函数可以支持传递任意可调用对象，并根据传递的参数类型自动推导返回类型。
+            返回类型为std::future且std::future的模板参数是typenamestd::result_of<F(Args...)>::type
+            即F在参数Args... 下的调用结果类型
+
+            ->是尾置返回类型，在 C++11 中引入了尾置返回类型的语法，
+            允许在函数定义的末尾使用 auto 关键字和尾置返回类型来指定函数的返回类型。
+        */
+
+        /*
+            post：提交一个不需要返回值的任务（fire-and-forget）
+            不创建std::packaged_task和std::future，可调用对象和参数足够小时整个提交过程不分配堆内存
+            注意：post的任务抛出的异常没有future可以接收，会导致std::terminate
+        */
+        template<class F,class... Args>
+        void post(F&& f,Args&&... args);
+
+        /*
+            指定优先级提交：High的任务总是先于Normal和Low执行（已经开始执行的任务不会被打断），
+            同一优先级内先进先出；在工作线程内部提交的Normal任务仍然进入本地队列，High和Low总是进入全局队列
+        */
+        template<class F,class... Args>
+        auto enqueue(Priority priority,F&& f,Args&&... args)
+        -> std::future<typename std::result_of<F(Args...)>::type>;
+        template<class F,class... Args>
+        void post(Priority priority,F&& f,Args&&... args);
+
+        /*
+            post_deadline：提交到EDF通道，EDF通道优先于所有优先级通道，其中deadline最早的任务最先执行
+            （deadline只决定顺序，过期的任务照样执行，不会被丢弃）
+        */
+        template<class F>
+        void post_deadline(std::chrono::steady_clock::time_point deadline,F&& f);
+
+        //低优先级通道被更高的通道连续抢先多少次之后，强制执行一个低优先级任务（默认32）
+        void set_starvation_limit(unsigned limit){
+            std::lock_guard<std::mutex>lock(queue_mutex);
+            tasks.set_starvation_limit(limit);
+        }
+
+        /*
+            enqueue_bulk：把[first,last)中的可调用对象（void()）全部移动到线程池中执行，返回提交的任务数
+            整批任务只获取一次锁，并且只唤醒min(任务数,睡眠线程数)个工作线程
+            和post一样不返回future
+        */
+        template<class It>
+        size_t enqueue_bulk(It first,It last);
+
+        /*
+            post_at：deadline之后把f（void()）提交到线程池执行，等待期间不占用工作线程
+            schedule_after：delay之后执行f，返回的TimerHandle可以用cancel取消
+            schedule_every：每隔period执行一次f（按固定频率，第一次在period之后），直到cancel；
+            上一次还没有执行完时跳过这一次
+            定时器的精度是timer_tick（1毫秒），到期时间向上取整到tick，不会提前执行；
+            线程池析构时还没有到期的任务会被直接丢弃
+        */
+        using TimerHandle=TimerWheel<TimerEntry>::Handle;
+        template<class F>
+        void post_at(std::chrono::steady_clock::time_point deadline,F&& f);
+        template<class F>
+        TimerHandle schedule_after(std::chrono::steady_clock::duration delay,F&& f);
+        template<class F>
+        TimerHandle schedule_every(std::chrono::steady_clock::duration period,F&& f);
+        //取消还没有到期的定时器，已经交给线程池的任务不受影响；定时器已经到期或者已经取消时返回false
+        bool cancel(TimerHandle handle);
+
+        /*
+            post_to：把f（void()）交给第worker个工作线程执行，不会被其他线程取走或窃取；
+            适合按工作线程划分状态的任务（例如每个工作线程一份的缓存），数据一直留在同一个核的缓存中
+        */
+        template<class F>
+        void post_to(size_t worker,F&& f);
+
+        //第i个工作线程绑定的CPU，没有绑定或绑定失败时返回-1
+        int worker_cpu(size_t i)const{return local_queues[i]->cpu;}
+
+#if defined(__cpp_impl_coroutine)
+        /*
+            schedule：协程中co_await pool.schedule()会挂起当前协程，并把它的恢复作为一个任务交给线程池，
+            之后的代码在某个工作线程上继续执行（需要C++20，见coro_task.h）
+        */
+        struct ScheduleAwaiter{
+            ThreadPool& pool;
+            bool await_ready()const noexcept{return false;}
+            void await_suspend(std::coroutine_handle<>h){
+                pool.post([h]{h.resume();});
+            }
+            void await_resume()const noexcept{}
+        };
+        ScheduleAwaiter schedule(){return ScheduleAwaiter{*this};}
+#endif
+
+        size_t size()const{return workers.size();}
+
+#if defined(THREAD_POOL_METRICS)
+        /*
+            stats：汇总所有工作线程的指标，返回一个快照（见pool_metrics.h），不获取任何队列锁
+            report_stats_every：每隔period把快照交给sink(const PoolStats&)，例如打印到日志；
+            sink在工作线程上调用，线程池析构后停止
+        */
+        PoolStats stats()const;
+        template<class F>
+        void report_stats_every(std::chrono::steady_clock::duration period,F sink);
+#endif
+
+        ~ThreadPool();
+};
+
+//lambda表达式在ThreadPool构造函数中定义，因此可以直接访问ThreadPool类的成员
+inline ThreadPool::ThreadPool(size_t threads,Mode mode,WaitPolicy wait,Affinity affinity)
+    :stop(false),mode(mode),wait_policy(wait){
+#if defined(THREAD_POOL_METRICS)
+    for(size_t i=0;i<threads;++i)
+        metrics.emplace_back(new pool_metrics::WorkerMetrics);
+#endif
+    for(size_t i=0;i<threads;++i)
+        local_queues.emplace_back(new WorkerQueue);
+    //窃取顺序：没有绑定时依次尝试右边的邻居；绑定后按拓扑距离排序，距离相同的仍按环形顺序
+    CpuTopology topology;
+    if(affinity.enabled())
+        topology=CpuTopology::detect();
+    for(size_t i=0;i<threads;++i){
+        std::vector<size_t>& order=local_queues[i]->steal_order;
+        for(size_t k=1;k<threads;++k)
+            order.push_back((i+k)%threads);
+        if(affinity.enabled()){
+            std::stable_sort(order.begin(),order.end(),[&](size_t a,size_t b){
+                return topology.distance(affinity.cpu_for(i),affinity.cpu_for(a))
+                      <topology.distance(affinity.cpu_for(i),affinity.cpu_for(b));
+            });
+        }
+    }
+    for(size_t i=0;i<threads;++i){//使用循环创建指定数量的工作线程
+        workers.emplace_back([this,i]{//lambda表达式捕获了this指针，以便在线程函数内部访问ThreadPool对象的成员
+            current_pool=this;
+            current_index=i;
+            if(this->mode==Mode::WorkStealing)
+                run_stealing(i);
+            else
+                run_shared(i);
+#if defined(THREAD_POOL_METRICS)
+            metrics[i]->flush();
+#endif
+        });
+        if(affinity.enabled()&&pin_thread(workers.back(),affinity.cpu_for(i)))
+            local_queues[i]->cpu=affinity.cpu_for(i);//工作线程自己不读cpu，只有worker_cpu()读
+    }
+}
+/*
+    :stop(false)为使用成员初始化列表的方式对成员变量进行初始化，stop 是 ThreadPool 类的一个成员变量，它在成员初始化列表中被初始化为 false。
+    使用成员初始化列表的优点是可以直接为成员变量提供初始值，而不需要在构造函数体内使用赋值操作符来初始化成员变量。
+    这样可以提高代码的效率，并避免一些潜在的问题。
+*/
+
+inline void ThreadPool::run_shared(size_t index){
+    for(;;){
+        Task task;
+        if(pop_pinned(index,task)){
+            execute(index,task,false);
+            continue;
+        }
+        {
+            std::unique_lock<std::mutex>lock(this->queue_mutex);
+            if(this->tasks.empty()){
+                bool stopping=this->stop;
+                lock.unlock();
+                /*
+                线程池正在关闭时，工作线程会先把队列中剩余的任务执行完，
+                队列为空后才退出，确保线程池能够安全地关闭,不会有未处理的任务遗留下来。
+                */
+                if(stopping){
+                    if(may_exit(index))
+                        return;
+                    continue;
+                }
+                wait_for_work(index);//等到stop为true或任务队列不为空
+                continue;
+            }
+            this->tasks.pop(task);//按优先级取出下一个任务，内部用std::move把任务移动出来
+            urgent.store(this->tasks.urgent(),std::memory_order_relaxed);
+            pending.fetch_sub(1,std::memory_order_relaxed);
+        }
+        execute(index,task,false);
+    }
+}
+
+inline void ThreadPool::run_stealing(size_t index){
+    for(;;){
+        Task task;
+        if(pop_pinned(index,task)){
+            execute(index,task,false);
+            continue;
+        }
+        //依次尝试：（有紧急任务时先取全局队列）本地队列 -> 全局队列 -> 窃取其他线程的队列
+        if((urgent.load(std::memory_order_relaxed)>0&&pop_global(task))||pop_local(index,task)||pop_global(task)){
+            pending.fetch_sub(1);
+            execute(index,task,false);
+            continue;
+        }
+        if(steal(index,task)){
+            pending.fetch_sub(1);
+            execute(index,task,true);
+            continue;
+        }
+        if(stop.load()&&pending.load()==0){
+            if(may_exit(index))
+                return;
+            continue;
+        }
+        wait_for_work(index);
+    }
+}
+
+/*
+    按wait_policy等待，直到有未取走的任务、有绑定到这个线程的任务或线程池停止
+    提交方先增加pending再notify，notify只有在看到有线程准备睡眠时才做系统调用；
+    ParkingSpot保证两边至少有一方能看到对方的修改，不会丢失唤醒
+*/
+inline void ThreadPool::wait_for_work(size_t index){
+    WorkerQueue& q=*local_queues[index];
+    auto ready=[this,&q]{
+        return pending.load()>0||q.pinned_count.load()>0||stop.load();
+    };
+#if defined(THREAD_POOL_METRICS)
+    //只有真正睡眠时才计时：自旋、让出阶段就等到任务时不读时钟，这段时间计入busy
+    pool_metrics::WorkerMetrics& m=*metrics[index];
+    uint64_t sleep_start=0;
+    wait_until(parking,wait_policy,ready,[&m,&sleep_start]{
+        m.flush();//睡眠之前发布本地计数，空闲时stats()看到的是准确的任务数
+        sleep_start=pool_metrics::now_ns();
+        m.sleeping_since.store(sleep_start,std::memory_order_relaxed);
+    });
+    if(sleep_start){
+        pool_metrics::add(m.idle_ns,pool_metrics::now_ns()-sleep_start);
+        m.sleeping_since.store(0,std::memory_order_relaxed);
+    }
+#else
+    wait_until(parking,wait_policy,ready);
+#endif
+}
+
+//在工作线程index上执行一个任务；开启指标时计数，并为被抽样的任务记录排队时间和执行时间
+inline void ThreadPool::execute(size_t index,Task& task,bool stolen){
+#if defined(THREAD_POOL_METRICS)
+    pool_metrics::WorkerMetrics& m=*metrics[index];
+    if(uint64_t enqueued=task.stamp()){
+        uint64_t start=pool_metrics::now_ns();
+        m.wait_ns.record(start-enqueued);
+        task();
+        m.exec_ns.record(pool_metrics::now_ns()-start);
+    }else{
+        task();
+    }
+    m.count(stolen);
+#else
+    (void)index;
+    (void)stolen;
+    task();
+#endif
+}
+
+inline bool ThreadPool::pop_pinned(size_t index,Task& task){
+    WorkerQueue& q=*local_queues[index];
+    if(q.pinned_count.load(std::memory_order_relaxed)==0)
+        return false;
+    std::lock_guard<std::mutex>lock(q.mutex);
+    if(q.pinned.empty())
+        return false;
+    task=std::move(q.pinned.front());
+    q.pinned.pop_front();
+    q.pinned_count.fetch_sub(1);
+    return true;
+}
+
+/*
+    stop已经为true时调用：在本地队列的锁内确认没有绑定到这个线程的任务。
+    post_to在同一把锁内检查stop，因此这里返回true之后不会再有任务绑定到这个线程
+*/
+inline bool ThreadPool::may_exit(size_t index){
+    WorkerQueue& q=*local_queues[index];
+    std::lock_guard<std::mutex>lock(q.mutex);
+    return q.pinned.empty();
+}
+
+inline bool ThreadPool::pop_local(size_t index,Task& task){
+    WorkerQueue& q=*local_queues[index];
+    std::lock_guard<std::mutex>lock(q.mutex);
+    if(q.tasks.empty())
+        return false;
+    task=std::move(q.tasks.back());
+    q.tasks.pop_back();
+    return true;
+}
+
+inline bool ThreadPool::pop_global(Task& task){
+    std::lock_guard<std::mutex>lock(queue_mutex);
+    if(!tasks.pop(task))
+        return false;
+    urgent.store(tasks.urgent(),std::memory_order_relaxed);
+    return true;
+}
+
+inline bool ThreadPool::steal(size_t index,Task& task){
+    for(size_t v:local_queues[index]->steal_order){
+        WorkerQueue& victim=*local_queues[v];
+        //try_lock：被窃取的队列正忙就换下一个，不在别人的锁上排队
+        std::unique_lock<std::mutex>lock(victim.mutex,std::try_to_lock);
+        if(!lock.owns_lock()||victim.tasks.empty())
+            continue;
+        task=std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+//开启指标时按抽样给任务打上提交时间（见pool_metrics.h），执行时据此计算排队时间
+inline void ThreadPool::sample(Task& task){
+#if defined(THREAD_POOL_METRICS)
+    task.set_stamp(pool_metrics::sample_enqueue());
+#else
+    (void)task;
+#endif
+}
+
+inline void ThreadPool::push(Task task,Priority priority){
+    sample(task);
+    if(mode==Mode::WorkStealing&&current_pool==this&&priority==Priority::Normal){
+        //工作线程内部提交：放入本地队列，不触碰全局的queue_mutex
+        //先增加pending再入队，避免任务被其他线程取走后pending短暂下溢
+        WorkerQueue& q=*local_queues[current_index];
+        pending.fetch_add(1);
+        {
+            std::lock_guard<std::mutex>lock(q.mutex);
+            q.tasks.emplace_back(std::move(task));
+        }
+        parking.notify(1);
+        return;
+    }
+    push_global(priority,std::move(task));
+}
+
+//放入全局队列的某个通道：key是Priority或者EDF通道的deadline
+template<class Key>
+void ThreadPool::push_global(Key key,Task task){
+    {
+        std::unique_lock<std::mutex>lock(queue_mutex);
+        if(stop)
+            throw std::runtime_error("enqueue on stopped ThreadPool");
+        tasks.push(key,std::move(task));
+        urgent.store(tasks.urgent(),std::memory_order_relaxed);
+        pending.fetch_add(1);
+    }
+    parking.notify(1);//通知工作线程有新任务加入，让他们尽快取出并执行；没有线程睡眠时不需要系统调用
+}
+
+template<class It>
+size_t ThreadPool::push_bulk(It first,It last){
+    if(mode==Mode::WorkStealing&&current_pool==this){
+        WorkerQueue& q=*local_queues[current_index];
+        size_t n=0;
+        {
+            std::lock_guard<std::mutex>lock(q.mutex);
+            for(;first!=last;++first,++n){
+                Task task(std::move(*first));
+                if(n==0)
+                    sample(task);//每批只抽样第一个任务
+                q.tasks.push_back(std::move(task));
+            }
+            pending.fetch_add(n);//在本地锁内增加，窃取方要拿到同一把锁才能取走这些任务
+        }
+        parking.notify(n);
+        return n;
+    }
+    size_t n=0;
+    {
+        std::unique_lock<std::mutex>lock(queue_mutex);
+        if(stop)
+            throw std::runtime_error("enqueue on stopped ThreadPool");
+        for(;first!=last;++first,++n){
+            Task task(std::move(*first));
+            if(n==0)
+                sample(task);
+            tasks.push(Priority::Normal,std::move(task));
+        }
+        pending.fetch_add(n);
+    }
+    parking.notify(n);
+    return n;
+}
+
+//add new work item to the pool
+template<class F,class... Args>
+auto ThreadPool::enqueue(F&& f,Args&&... args)
+->std::future<typename std::result_of<F(Args...)>::type>{
+    return enqueue(Priority::Normal,std::forward<F>(f),std::forward<Args>(args)...);
+}
+
+template<class F,class... Args>
+auto ThreadPool::enqueue(Priority priority,F&& f,Args&&... args)
+->std::future<typename std::result_of<F(Args...)>::type>{
+    using return_type=typename std::result_of<F(Args...)>::type;
+    std::packaged_task<return_type()>task(
+        [fn=std::forward<F>(f),tup=std::make_tuple(std::forward<Args>(args)...)]()mutable{
+            return std::apply(std::move(fn),std::move(tup));
+        }
+    );
+    /*
+        std::packaged_task<return_type()>是一个类型模板，他表示一个可调用对象，返回类型为return_type
+        lambda通过初始化捕获把f和参数args按值保存下来（代替std::bind），std::apply在调用时把tuple展开成参数
+        std::forward<F>(f) 和 std::forward<Args>(args)... 利用完美转发保留了参数的左值/右值属性。
+
+        packaged_task只能移动，不能拷贝。以前必须用make_shared把它包进shared_ptr才能放进std::function，
+        现在队列中的Task本身就是只能移动的，packaged_task直接按值放进Task的内部缓冲区，
+        整个提交过程只剩下packaged_task共享状态的一次分配
+    */
+    std::future<return_type>res=task.get_future();
+    /*
+        获取与packaged_task关联的std::future<return_type>对象
+    */
+    push(Task(std::move(task)),priority);
+    return res;
+}
+
+template<class F,class... Args>
+void ThreadPool::post(F&& f,Args&&... args){
+    post(Priority::Normal,std::forward<F>(f),std::forward<Args>(args)...);
+}
+
+template<class F,class... Args>
+void ThreadPool::post(Priority priority,F&& f,Args&&... args){
+    if constexpr(sizeof...(Args)==0){
+        push(Task(std::forward<F>(f)),priority);
+    }else{
+        push(Task([fn=std::forward<F>(f),tup=std::make_tuple(std::forward<Args>(args)...)]()mutable{
+            std::apply(std::move(fn),std::move(tup));
+        }),priority);
+    }
+}
+
+template<class F>
+void ThreadPool::post_deadline(std::chrono::steady_clock::time_point deadline,F&& f){
+    Task task(std::forward<F>(f));
+    sample(task);
+    push_global(deadline,std::move(task));
+}
+
+template<class It>
+size_t ThreadPool::enqueue_bulk(It first,It last){
+    return push_bulk(first,last);
+}
+
+//时间点换算成tick，向上取整，保证定时器不会提前到期
+inline uint64_t ThreadPool::timer_ticks(std::chrono::steady_clock::time_point t)const{
+    if(t<=timer_origin)
+        return 0;
+    return static_cast<uint64_t>((t-timer_origin+timer_tick-std::chrono::steady_clock::duration(1))/timer_tick);
+}
+
+inline ThreadPool::TimerHandle ThreadPool::add_timer(uint64_t tick,TimerEntry entry){
+    TimerHandle handle;
+    bool wake;
+    {
+        std::lock_guard<std::mutex>lock(timer_mutex);
+        if(timer_stop)
+            return handle;//线程池正在析构（例如report_stats_every在最后一个任务中重新注册），直接丢弃
+        if(!timer_thread.joinable())
+            timer_thread=std::thread([this]{run_timer();});
+        handle=timers.insert(tick,std::move(entry));
+        wake=tick<timer_wakeup;
+    }
+    if(wake)
+        timer_condition.notify_one();//只有新定时器比定时线程计划醒来的时间更早时才需要叫醒它
+    return handle;
+}
+
+template<class F>
+void ThreadPool::post_at(std::chrono::steady_clock::time_point deadline,F&& f){
+    add_timer(timer_ticks(deadline),TimerEntry{Task(std::forward<F>(f)),nullptr});
+}
+
+template<class F>
+ThreadPool::TimerHandle ThreadPool::schedule_after(std::chrono::steady_clock::duration delay,F&& f){
+    return add_timer(timer_ticks(std::chrono::steady_clock::now()+delay),TimerEntry{Task(std::forward<F>(f)),nullptr});
+}
+
+template<class F>
+ThreadPool::TimerHandle ThreadPool::schedule_every(std::chrono::steady_clock::duration period,F&& f){
+    auto periodic=std::make_shared<Periodic>();
+    periodic->fn=Task(std::forward<F>(f));
+    periodic->period=std::max<uint64_t>(1,static_cast<uint64_t>((period+timer_tick-std::chrono::steady_clock::duration(1))/timer_tick));
+    return add_timer(timer_ticks(std::chrono::steady_clock::now()+period),TimerEntry{Task(),std::move(periodic)});
+}
+
+inline bool ThreadPool::cancel(TimerHandle handle){
+    std::lock_guard<std::mutex>lock(timer_mutex);
+    return timers.cancel(handle);
+}
+
+inline void ThreadPool::run_timer(){
+    std::unique_lock<std::mutex>lock(timer_mutex);
+    while(!timer_stop){
+        timer_wakeup=0;
+        uint64_t now=static_cast<uint64_t>((std::chrono::steady_clock::now()-timer_origin)/timer_tick);//向下取整
+        timers.advance(now,[this](TimerEntry& entry)->uint64_t{
+            if(!entry.periodic){
+                due.push_back(std::move(entry.task));
+                return 0;
+            }
+            std::shared_ptr<Periodic>p=entry.periodic;
+            if(!p->running.exchange(true,std::memory_order_acquire)){
+                due.push_back(Task([p]{
+                    struct Done{
+                        Periodic& p;
+                        ~Done(){p.running.store(false,std::memory_order_release);}
+                    }done{*p};
+                    p->fn();
+                }));
+            }
+            return timers.now()+p->period;
+        });
+        if(!due.empty()){
+            lock.unlock();
+            push_bulk(due.begin(),due.end());//一次加锁放入所有到期的任务
+            due.clear();
+            lock.lock();
+            continue;//放入任务期间可能有新的定时器到期
+        }
+        uint64_t next=timers.next_expiry();
+        if(next==0){
+            timer_wakeup=UINT64_MAX;
+            timer_condition.wait(lock);
+        }else{
+            timer_wakeup=next;
+            timer_condition.wait_until(lock,timer_origin+next*timer_tick);
+        }
+    }
+}
+
+template<class F>
+void ThreadPool::post_to(size_t worker,F&& f){
+    if(worker>=local_queues.size())
+        throw std::out_of_range("post_to: no such worker");
+    WorkerQueue& q=*local_queues[worker];
+    {
+        std::lock_guard<std::mutex>lock(q.mutex);
+        if(stop)
+            throw std::runtime_error("enqueue on stopped ThreadPool");
+        Task task(std::forward<F>(f));
+        sample(task);
+        q.pinned.push_back(std::move(task));
+        q.pinned_count.fetch_add(1);
+    }
+    //不知道目标线程是不是正在睡眠，唤醒所有睡眠的线程，其他线程检查条件后会重新睡眠；没有线程睡眠时没有系统调用
+    parking.notify_all();
+}
+
+#if defined(THREAD_POOL_METRICS)
+inline PoolStats ThreadPool::stats()const{
+    PoolStats s{};
+    s.queue_depth=pending.load(std::memory_order_relaxed);
+    for(const std::unique_ptr<WorkerQueue>& q:local_queues)
+        s.queue_depth+=q->pinned_count.load(std::memory_order_relaxed);
+    s.idle_workers=parking.waiters();
+    uint64_t now=pool_metrics::now_ns();
+    for(const std::unique_ptr<pool_metrics::WorkerMetrics>& m:metrics){
+        PoolWorkerStats w{m->tasks.load(std::memory_order_relaxed),m->steals.load(std::memory_order_relaxed),
+                          0,m->idle_ns.load(std::memory_order_relaxed)};
+        uint64_t since=m->sleeping_since.load(std::memory_order_relaxed);
+        if(since&&since<now)
+            w.idle_ns+=now-since;//正在睡眠的线程：加上到现在为止的睡眠时间
+        uint64_t alive=now-m->started_ns;
+        w.busy_ns=alive>w.idle_ns?alive-w.idle_ns:0;
+        s.tasks+=w.tasks;
+        s.steals+=w.steals;
+        s.busy_ns+=w.busy_ns;
+        s.idle_ns+=w.idle_ns;
+        s.workers.push_back(w);
+        s.queue_wait_ns.merge(m->wait_ns);
+        s.exec_ns.merge(m->exec_ns);
+    }
+    return s;
+}
+
+template<class F>
+void ThreadPool::report_stats_every(std::chrono::steady_clock::duration period,F sink){
+    schedule_every(period,[this,sink]()mutable{
+        sink(stats());
+    });
+}
+#endif
+
+inline ThreadPool::~ThreadPool(){
+    //先停止定时线程，保证析构开始后不会再有延时任务被提交
+    {
+        std::lock_guard<std::mutex>lock(timer_mutex);
+        timer_stop=true;
+    }
+    timer_condition.notify_one();
+    if(timer_thread.joinable())
+        timer_thread.join();
+    {
+        //还没有到期的定时器在这里销毁，此时线程池还能接收任务：
+        //定时任务持有的PoolPromise析构时以broken_promise完成，它的后续任务仍然会被执行
+        TimerWheel<TimerEntry>pending_timers;
+        {
+            std::lock_guard<std::mutex>lock(timer_mutex);
+            std::swap(pending_timers,timers);
+        }
+    }
+    {
+        std::unique_lock<std::mutex>lock(queue_mutex);
+        stop=true;
+    }
+    parking.notify_all();
+    for(std::thread&worker:workers){
+        worker.join();
+    }
+}
@@ -0,0 +1,230 @@
+#pragma once
+#include<cstddef>
+#include<cstdint>
+#include<utility>
+#include<vector>
+
+/*
+    分层时间轮（hierarchical timing wheel），ThreadPool的定时线程用它管理延时任务和周期任务（本身不是线程安全的，由timer_mutex保护）
+
+    时间以tick为单位。共levels层，每层slots个槽位（256），第l层的一个槽位覆盖256^l个tick：
+    * 到期时间距离当前不到256个tick的定时器放在第0层，按到期tick直接定位到槽位；更远的放到更高的层
+    * 每前进一个tick处理第0层的一个槽位；第0层转完一圈时把第1层下一个槽位中的定时器"降级"（cascade）重新放到低层，以此类推
+    * 槽位是侵入式双向链表，插入和取消都是O(1)；节点放在vector中并用空闲链表复用，
+      稳定状态下插入不分配内存。Handle带有代数（generation），节点被复用后旧的Handle取消时不会误删
+    * 每层有一个256位的占用位图：第0层为空时直接跳到下一次降级的tick，next_expiry()用它找到最早需要处理的tick
+    * 超出四层范围（256^4个tick）的定时器先放在最高层，降级时按真实的到期时间重新放置，不会提前到期
+*/
+
+template<class T>
+class TimerWheel{
+    private:
+        static constexpr unsigned bits=8;
+        static constexpr size_t slots=size_t(1)<<bits;
+        static constexpr uint64_t mask=slots-1;
+        static constexpr unsigned levels=4;
+        static constexpr uint32_t npos=UINT32_MAX;
+
+        struct Node{
+            T item;
+            uint64_t expires=0;//真实的到期tick
+            uint32_t prev=npos;
+            uint32_t next=npos;
+            uint32_t generation=0;
+            uint16_t slot=0;
+            uint8_t level=0;
+            bool active=false;
+        };
+
+        std::vector<Node>nodes;
+        std::vector<uint32_t>free_nodes;
+        uint32_t heads[levels][slots];
+        uint64_t occupied[levels][slots/64]={};
+        uint64_t current;
+        size_t count=0;
+
+        void set_bit(unsigned level,size_t slot){occupied[level][slot/64]|=uint64_t(1)<<(slot%64);}
+        void clear_bit(unsigned level,size_t slot){occupied[level][slot/64]&=~(uint64_t(1)<<(slot%64));}
+
+        bool level_empty(unsigned level)const{
+            for(uint64_t word:occupied[level]){
+                if(word)
+                    return false;
+            }
+            return true;
+        }
+
+        //从start开始（循环）找第一个非空槽位，返回距离start的偏移，没有时返回slots
+        size_t first_occupied(unsigned level,size_t start)const{
+            for(size_t step=0;step<slots;){
+                size_t slot=(start+step)&mask;
+                uint64_t word=occupied[level][slot/64]>>(slot%64);
+                if(word)
+                    return step+static_cast<size_t>(__builtin_ctzll(word));
+                step+=64-slot%64;
+            }
+            return slots;
+        }
+
+        //按到期时间放到合适的层和槽位；expires不早于current
+        void link(uint32_t index){
+            Node& n=nodes[index];
+            uint64_t delta=n.expires-current;
+            uint64_t placed=n.expires;
+            unsigned level=0;
+            while(level+1<levels&&delta>=(uint64_t(1)<<(bits*(level+1))))
+                ++level;
+            if(delta>=(uint64_t(1)<<(bits*levels)))
+                placed=current+(uint64_t(1)<<(bits*levels))-1;//超出范围：先放到最高层最远的槽位
+            size_t slot=(placed>>(bits*level))&mask;
+            n.level=static_cast<uint8_t>(level);
+            n.slot=static_cast<uint16_t>(slot);
+            n.prev=npos;
+            n.next=heads[level][slot];
+            if(n.next!=npos)
+                nodes[n.next].prev=index;
+            heads[level][slot]=index;
+            set_bit(level,slot);
+        }
+
+        void unlink(uint32_t index){
+            Node& n=nodes[index];
+            if(n.prev!=npos)
+                nodes[n.prev].next=n.next;
+            else
+                heads[n.level][n.slot]=n.next;
+            if(n.next!=npos)
+                nodes[n.next].prev=n.prev;
+            if(heads[n.level][n.slot]==npos)
+                clear_bit(n.level,n.slot);
+        }
+
+        void release(uint32_t index){
+            Node& n=nodes[index];
+            n.active=false;
+            n.item=T();
+            ++n.generation;
+            free_nodes.push_back(index);
+            --count;
+        }
+
+        //把level层当前槽位中的定时器重新放到更低的层
+        void cascade(unsigned level){
+            size_t slot=(current>>(bits*level))&mask;
+            if(slot==0&&level+1<levels)
+                cascade(level+1);
+            uint32_t index=heads[level][slot];
+            heads[level][slot]=npos;
+            clear_bit(level,slot);
+            while(index!=npos){
+                uint32_t next=nodes[index].next;
+                link(index);
+                index=next;
+            }
+        }
+
+    public:
+        struct Handle{
+            uint32_t index=npos;
+            uint32_t generation=0;
+        };
+
+        explicit TimerWheel(uint64_t now=0):current(now){
+            for(auto& level:heads){
+                for(uint32_t& head:level)
+                    head=npos;
+            }
+        }
+
+        uint64_t now()const{return current;}
+        size_t size()const{return count;}
+        bool empty()const{return count==0;}
+
+        //到期tick不晚于当前tick时在下一个tick到期
+        Handle insert(uint64_t expires,T item){
+            uint32_t index;
+            if(free_nodes.empty()){
+                index=static_cast<uint32_t>(nodes.size());
+                nodes.emplace_back();
+            }else{
+                index=free_nodes.back();
+                free_nodes.pop_back();
+            }
+            Node& n=nodes[index];
+            n.item=std::move(item);
+            n.expires=expires>current?expires:current+1;
+            n.active=true;
+            link(index);
+            ++count;
+            return Handle{index,n.generation};
+        }
+
+        //定时器已经到期、已经取消或者Handle无效时返回false
+        bool cancel(Handle h){
+            if(h.index>=nodes.size())
+                return false;
+            Node& n=nodes[h.index];
+            if(!n.active||n.generation!=h.generation)
+                return false;
+            unlink(h.index);
+            release(h.index);
+            return true;
+        }
+
+        /*
+            前进到tick now，依次对到期的定时器调用on_expire(T& item)：
+            返回0表示完成（节点被回收），返回一个tick表示在那时再次到期（周期定时器，Handle保持有效）
+        */
+        template<class F>
+        void advance(uint64_t now,F on_expire){
+            while(current<now){
+                if(count==0){
+                    current=now;
+                    return;
+                }
+                ++current;
+                size_t slot=current&mask;
+                if(slot==0)
+                    cascade(1);
+                uint32_t index=heads[0][slot];
+                heads[0][slot]=npos;
+                clear_bit(0,slot);
+                while(index!=npos){
+                    uint32_t next=nodes[index].next;
+                    uint64_t again=on_expire(nodes[index].item);
+                    if(again){
+                        nodes[index].expires=again>current?again:current+1;
+                        link(index);
+                    }else{
+                        release(index);
+                    }
+                    index=next;
+                }
+                if(level_empty(0)){//第0层没有定时器：直接跳到下一次降级之前
+                    uint64_t before_cascade=current|mask;
+                    current=before_cascade<now?before_cascade:now;
+                }
+            }
+        }
+
+        //下一个需要处理的tick（到期或者降级），没有定时器时返回0
+        uint64_t next_expiry()const{
+            if(count==0)
+                return 0;
+            uint64_t best=UINT64_MAX;
+            size_t step=first_occupied(0,(current+1)&mask);
+            if(step<slots)
+                best=current+1+step;
+            for(unsigned level=1;level<levels;++level){
+                unsigned shift=bits*level;
+                uint64_t block=current>>shift;
+                size_t offset=first_occupied(level,(block+1)&mask);
+                if(offset==slots)
+                    continue;
+                uint64_t tick=(block+1+offset)<<shift;
+                if(tick<best)
+                    best=tick;
+            }
+            return best;
+        }
+};
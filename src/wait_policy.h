@@ -0,0 +1,156 @@
+#pragma once
+#include<atomic>
+#include<climits>
+#include<cstddef>
+#include<cstdint>
+#include<thread>
+#if defined(__linux__)
+#include<linux/futex.h>
+#include<sys/syscall.h>
+#include<unistd.h>
+#else
+#include<condition_variable>
+#include<mutex>
+#endif
+#if defined(__x86_64__)||defined(__i386__)
+#include<immintrin.h>
+#endif
+
+/*
+    等待策略：线程池的工作线程和阻塞队列（mpmc_queue.h、spsc_channel.h）在没有任务/元素时怎样等待
+
+    直接睡在condition_variable上，每次交接都要一次futex唤醒加一次上下文切换（几微秒到几十微秒），
+    对微秒级的任务来说这就是尾延迟的主要来源。WaitPolicy把等待分成三个阶段：
+    1. spin：循环检查条件，每次之间执行一条pause指令（让出流水线和超线程的另一半，不进入内核）
+    2. yield：每次检查之间调用std::this_thread::yield()，让同一个核上的其他线程先运行
+    3. park：在ParkingSpot上用futex睡眠，直到被唤醒
+    spins和yields是每个阶段检查的次数，park为false时不睡眠，一直yield
+    * blocking()：立即睡眠，和原来的condition_variable行为相同，不消耗额外的CPU
+    * adaptive()（默认）：先自旋几微秒再睡眠，短间隔的交接不进入内核（单核机器上跳过自旋）
+    * spinning()：从不睡眠，交接延迟最低，但空闲时也一直占用CPU（核数少于线程数时反而更慢）
+
+    ParkingSpot（event count）：唤醒方先检查有没有线程真正准备睡眠，没有时只是一次fence加一次load，不做系统调用
+*/
+
+inline void cpu_relax(){
+#if defined(__x86_64__)||defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield":::"memory");
+#endif
+}
+
+struct WaitPolicy{
+    unsigned spins=256;
+    unsigned yields=8;
+    bool park=true;
+
+    static constexpr WaitPolicy blocking(){return WaitPolicy{0,0,true};}
+    //只有一个CPU时自旋没有意义（对方不可能在自旋期间运行），直接从yield开始
+    static WaitPolicy adaptive(unsigned spins=256,unsigned yields=8){
+        static const bool uniprocessor=std::thread::hardware_concurrency()==1;
+        return WaitPolicy{uniprocessor?0:spins,yields,true};
+    }
+    static constexpr WaitPolicy spinning(unsigned spins=256){return WaitPolicy{spins,0,false};}
+};
+
+/*
+    等待方：key=prepare_park(); 再检查一次条件; 条件满足则cancel_park()，否则park(key)
+    唤醒方：先发布新状态（队列中的元素等），再notify
+    prepare_park增加parked之后有一个seq_cst fence，notify在读parked之前也有一个seq_cst fence，
+    因此要么唤醒方看到parked>0，要么等待方再检查条件时看到新状态，不会丢失唤醒；
+    唤醒方在futex_wake之前先修改epoch，prepare_park之后才发生的唤醒会让park(key)立即返回
+*/
+class ParkingSpot{
+    private:
+        std::atomic<uint32_t>epoch{0};
+        std::atomic<uint32_t>parked{0};
+#if !defined(__linux__)
+        std::mutex mutex;
+        std::condition_variable cv;
+#endif
+
+        void wake(int n){
+#if defined(__linux__)
+            syscall(SYS_futex,reinterpret_cast<uint32_t*>(&epoch),FUTEX_WAKE_PRIVATE,n,nullptr,nullptr,0);
+#else
+            std::lock_guard<std::mutex>lock(mutex);
+            if(n==1)
+                cv.notify_one();
+            else
+                cv.notify_all();
+#endif
+        }
+
+    public:
+        static_assert(sizeof(std::atomic<uint32_t>)==sizeof(uint32_t),"futex word must be a plain 32-bit integer");
+
+        uint32_t prepare_park(){
+            parked.fetch_add(1,std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            return epoch.load(std::memory_order_relaxed);
+        }
+
+        void cancel_park(){
+            parked.fetch_sub(1,std::memory_order_relaxed);
+        }
+
+        //epoch仍然等于key时睡眠；可能被虚假唤醒，调用方需要重新检查条件
+        void park(uint32_t key){
+#if defined(__linux__)
+            syscall(SYS_futex,reinterpret_cast<uint32_t*>(&epoch),FUTEX_WAIT_PRIVATE,key,nullptr,nullptr,0);
+#else
+            std::unique_lock<std::mutex>lock(mutex);
+            cv.wait(lock,[&]{return epoch.load(std::memory_order_relaxed)!=key;});
+#endif
+            parked.fetch_sub(1,std::memory_order_relaxed);
+        }
+
+        //唤醒最多n个已经（或正准备）睡眠的线程；没有这样的线程时不做系统调用
+        void notify(size_t n=1){
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(n==0||parked.load(std::memory_order_relaxed)==0)
+                return;
+            epoch.fetch_add(1,std::memory_order_relaxed);
+            wake(n>=static_cast<size_t>(INT_MAX)?INT_MAX:static_cast<int>(n));
+        }
+
+        void notify_all(){notify(INT_MAX);}
+
+        //正在睡眠（或正准备睡眠）的线程数
+        size_t waiters()const{return parked.load(std::memory_order_relaxed);}
+};
+
+//按policy等待ready()返回true；ready需要是无副作用的检查，可能被调用很多次
+//on_park在第一次真正睡眠之前调用一次，在自旋或让出阶段就等到时不调用
+template<class Ready,class OnPark>
+void wait_until(ParkingSpot& spot,const WaitPolicy& policy,Ready ready,OnPark on_park){
+    for(unsigned i=0;i<policy.spins;++i){
+        if(ready())
+            return;
+        cpu_relax();
+    }
+    for(unsigned i=0;i<policy.yields||!policy.park;++i){
+        if(ready())
+            return;
+        std::this_thread::yield();
+    }
+    bool first=true;
+    while(!ready()){
+        uint32_t key=spot.prepare_park();
+        if(ready()){
+            spot.cancel_park();
+            return;
+        }
+        if(first){
+            on_park();
+            first=false;
+        }
+        spot.park(key);
+    }
+}
+
+template<class Ready>
+void wait_until(ParkingSpot& spot,const WaitPolicy& policy,Ready ready){
+    wait_until(spot,policy,ready,[]{});
+}